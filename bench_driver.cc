@@ -0,0 +1,60 @@
+/*! 
+ * Benchmark driver entry point for the event-driven programming CS225 assignment. 
+ */
+
+#include "bench_suite.hh"
+
+#include <cstdlib>      // std::atoi, std::atof
+#include <exception>    // std::exception
+#include <iostream>     // std::cout
+#include <string>       // std::string
+
+void print_instructions()
+{
+    static const std::string instructions_message
+    (
+       "Usage instructions: <program-executable> [options]\n"
+       "  --filter=TEXT         only run the benchmarks whose name contains TEXT\n"
+       "  --samples=N           number of timed samples per benchmark (default 20)\n"
+       "  --baseline=FILE       compare the results against a baseline file\n"
+       "  --threshold=X         relative slowdown flagged as a regression (default 0.10)\n"
+       "  --save-baseline=FILE  save the results as a baseline file\n"
+       "  -h, --help            display this message\n"
+       "The program returns a non-zero status if a regression is detected.\n"
+    );
+    std::cout << instructions_message << std::endl;
+}
+
+int main( int argc, const char** argv )
+{
+    BenchmarkOptions options;
+    for( int i = 1; i < argc; ++i )
+    {
+        std::string param = argv[i];
+
+        if( param.compare( 0, 9, "--filter=" ) == 0 )
+            options.filter = param.substr( 9 );
+        else if( param.compare( 0, 10, "--samples=" ) == 0 )
+            options.samples = static_cast<std::size_t>( std::atoi( param.c_str() + 10 ) );
+        else if( param.compare( 0, 11, "--baseline=" ) == 0 )
+            options.baseline_path = param.substr( 11 );
+        else if( param.compare( 0, 12, "--threshold=" ) == 0 )
+            options.threshold = std::atof( param.c_str() + 12 );
+        else if( param.compare( 0, 16, "--save-baseline=" ) == 0 )
+            options.save_path = param.substr( 16 );
+        else
+        {
+            print_instructions();
+            return param == "-h" || param == "--help" ? 0 : 2;
+        }
+    }
+
+    try
+    {
+        return BenchmarkSuite::run_all( options ) ? 0 : 1;
+
+    } catch( const std::exception& ex ) {
+        print( std::string( "Runtime error exception caught: \n" ) + ex.what() + "\n", colors::red );
+        return 1;
+    }
+}
@@ -0,0 +1,1344 @@
+/*!
+ * Benchmark suite for the CS225 event-driven programming assignment.
+ *
+ * Benchmarks are registered with the `BENCHMARK( "name" )` macro from testing.hh and run 
+ * from bench_driver.cc (`make bench`), compiled with optimizations on. Only the body of the 
+ * `while( state.keep_running() )` loop is timed, so the setup before it is free.
+ *
+ * Benchmarks that use the event dispatcher singleton must leave it clean (call `clear()`).
+ */
+
+#pragma once
+
+#include "testing.hh" // BENCHMARK, do_not_optimize
+using namespace testing;
+
+#include "event_dispatcher.hh" // cs225::Listener, cs225::EventDispatcher
+#include "columnar_stream.hh" // cs225::ColumnarStream
+#include "predicate_filter.hh" // cs225::Predicate, cs225::set_filter_kernel
+#include "event_queue.hh" // cs225::EventQueue, cs225::QueueLimit
+#include "event_stream.hh" // cs225::stream
+#include "shared_event.hh" // cs225::SharedEvent, cs225::make_shared_event
+#include "slot_map.hh" // cs225::SlotMap
+#include "thread_placement.hh" // cs225::ThreadPlacement, cs225::CpuTopology
+#include "tick_scheduler.hh" // cs225::TickScheduler, cs225::TickSystem
+#include "topic_channels.hh" // cs225::TopicChannels, cs225::TopicEvent
+
+#include <cstddef>      // std::size_t
+#include <cstdint>      // std::int32_t
+#if defined(__GLIBC__)
+    #include <malloc.h> // mallinfo2
+#endif
+#include <map>          // std::map
+#include <memory>       // std::unique_ptr
+#include <random>       // std::mt19937
+#include <string>       // std::string
+#include <unordered_map> // std::unordered_map
+#include <thread>       // std::thread
+#include <typeindex>    // std::type_index
+#include <vector>       // std::vector
+
+namespace Benchmarks
+{
+
+struct ChurnEvent : public cs225::Event {};
+
+struct NullListener : public cs225::Listener
+{
+    virtual void handle_event( const cs225::Event & ) {}
+};
+
+struct CountingListener : public cs225::Listener
+{
+    CountingListener() : count(0u) {}
+    virtual void handle_event( const cs225::Event & ) { count++; }
+    unsigned long count;
+};
+
+/*********************************************************************
+ *                        Subscription churn                         *
+ *********************************************************************/
+
+const std::size_t resident_count = 10000;
+
+// subscribe/unsubscribe pair on top of a resident population of subscribers: O(1) per pair
+BENCHMARK( "subscription churn: unsubscribe by token (10k resident subscribers)" )
+{
+    cs225::EventDispatcher & dispatcher = cs225::EventDispatcher::get_instance();
+    std::vector<NullListener> residents( resident_count );
+    for( NullListener & listener : residents )
+        dispatcher.subscribe( listener, cs225::type_of<ChurnEvent>() );
+
+    NullListener transient;
+    while( state.keep_running() )
+    {
+        cs225::SubscriptionToken token = dispatcher.subscribe( transient, cs225::type_of<ChurnEvent>() );
+        do_not_optimize( dispatcher.unsubscribe( token ) );
+    }
+
+    dispatcher.clear();
+}
+
+// same, but unsubscribing searches the subscriber collection
+// (the transient listener sits at the end, so this is the worst case)
+BENCHMARK( "subscription churn: unsubscribe by listener (10k resident subscribers)" )
+{
+    cs225::EventDispatcher & dispatcher = cs225::EventDispatcher::get_instance();
+    std::vector<NullListener> residents( resident_count );
+    for( NullListener & listener : residents )
+        dispatcher.subscribe( listener, cs225::type_of<ChurnEvent>() );
+
+    NullListener transient;
+    while( state.keep_running() )
+    {
+        dispatcher.subscribe( transient, cs225::type_of<ChurnEvent>() );
+        dispatcher.unsubscribe( transient, cs225::type_of<ChurnEvent>() );
+    }
+
+    dispatcher.clear();
+}
+
+// short-lived objects holding scoped subscriptions, all torn down at once
+BENCHMARK( "scoped subscriptions: 1k subscribe + teardown" )
+{
+    const std::size_t listener_count = 1000;
+
+    cs225::EventDispatcher & dispatcher = cs225::EventDispatcher::get_instance();
+    std::vector<NullListener> listeners( listener_count );
+    std::vector<cs225::ScopedSubscription> subscriptions;
+    subscriptions.reserve( listener_count );
+
+    while( state.keep_running() )
+    {
+        for( NullListener & listener : listeners )
+            subscriptions.push_back( dispatcher.subscribe_scoped( listener, cs225::type_of<ChurnEvent>() ) );
+        subscriptions.clear(); // every subscription is dropped here
+    }
+
+    dispatcher.clear();
+}
+
+/*********************************************************************
+ *                             Dispatch                              *
+ *********************************************************************/
+
+// triggering one event type with many subscribers: the dispatch iterates the subscribers in place
+BENCHMARK( "dispatch fan-out: 1 event to 1k subscribers" )
+{
+    const std::size_t listener_count = 1000;
+
+    cs225::EventDispatcher & dispatcher = cs225::EventDispatcher::get_instance();
+    std::vector<CountingListener> listeners( listener_count );
+    for( CountingListener & listener : listeners )
+        dispatcher.subscribe( listener, cs225::type_of<ChurnEvent>() );
+
+    while( state.keep_running() )
+        cs225::trigger_event( ChurnEvent() );
+    do_not_optimize( listeners[0].count );
+
+    dispatcher.clear();
+}
+
+/*********************************************************************
+ *                          Type identity                            *
+ *********************************************************************/
+
+template <int N>
+struct KeyType {};
+
+// fills the vector with the type infos of KeyType<0> ... KeyType<N - 1>
+template <int N>
+struct KeyTypes
+{
+    static void fill( std::vector<cs225::TypeInfo> & types )
+    {
+        KeyTypes<N - 1>::fill( types );
+        types.push_back( cs225::type_of< KeyType<N - 1> >() );
+    }
+};
+template <>
+struct KeyTypes<0>
+{
+    static void fill( std::vector<cs225::TypeInfo> & ) {}
+};
+
+// dispatch-table lookup keyed on the stable type hash
+BENCHMARK( "type keyed lookup: stable hash (64 types)" )
+{
+    std::vector<cs225::TypeInfo> types;
+    KeyTypes<64>::fill( types );
+    std::map<cs225::TypeInfo, int> table;
+    for( const cs225::TypeInfo & type : types )
+        table[type] = 1;
+
+    std::size_t i = 0;
+    while( state.keep_running() )
+        do_not_optimize( table.find( types[i++ % types.size()] )->second );
+}
+
+// the same lookup keyed on std::type_info ordering (what TypeInfo used to compare)
+BENCHMARK( "type keyed lookup: std::type_index (64 types)" )
+{
+    std::vector<cs225::TypeInfo> types;
+    KeyTypes<64>::fill( types );
+    std::vector<std::type_index> keys;
+    std::map<std::type_index, int> table;
+    for( const cs225::TypeInfo & type : types )
+    {
+        keys.push_back( std::type_index( type.get_type_info() ) );
+        table[keys.back()] = 1;
+    }
+
+    std::size_t i = 0;
+    while( state.keep_running() )
+        do_not_optimize( table.find( keys[i++ % keys.size()] )->second );
+}
+
+/*********************************************************************
+ *                   Per-object vs columnar events                   *
+ *********************************************************************/
+
+struct ClickEvent : public cs225::Event
+{
+    ClickEvent( int xx, int yy )
+        : x(xx), y(yy) {}
+
+    int x, y;
+};
+
+} // namespace Benchmarks
+
+namespace cs225
+{
+
+template <>
+struct ColumnLayout<Benchmarks::ClickEvent>
+{
+    using block_type = ColumnBlock<int, int>;
+
+    static void append( block_type & block, const Benchmarks::ClickEvent & event )
+    {
+        block.append( event.x, event.y );
+    }
+};
+
+} // namespace cs225
+
+namespace Benchmarks
+{
+
+const std::size_t click_count = 1000000;
+
+// click coordinates in a 1920x1080 screen
+inline std::vector<int> random_coordinates( std::size_t count, int limit, unsigned int seed )
+{
+    std::mt19937 random( seed );
+    std::uniform_int_distribution<int> distribution( 0, limit - 1 );
+    std::vector<int> values( count );
+    for( int & value : values )
+        value = distribution( random );
+    return values;
+}
+
+// counts the clicks that land inside a rectangle
+struct ClickCounter : public cs225::Listener
+{
+    ClickCounter() : inside(0u) {}
+
+    virtual void handle_event( const cs225::Event & event )
+    {
+        const ClickEvent & click = static_cast<const ClickEvent &>( event );
+        inside += click.x >= 100 && click.x < 600 && click.y >= 200 && click.y < 700;
+    }
+    unsigned long inside;
+};
+
+struct ColumnarClickCounter : public cs225::ColumnarListener<ClickEvent>
+{
+    ColumnarClickCounter() : inside(0u) {}
+
+    virtual void handle_block( const view_type & clicks )
+    {
+        const int * x = clicks.column<0>();
+        const int * y = clicks.column<1>();
+        unsigned long count = 0u;
+        for( std::size_t i = 0; i < clicks.size(); ++i )
+            count += x[i] >= 100 && x[i] < 600 && y[i] >= 200 && y[i] < 700;
+        inside += count;
+    }
+    unsigned long inside;
+};
+
+// each click is a polymorphic object triggered through the dispatcher
+BENCHMARK( "1M clicks: per-object events" )
+{
+    std::vector<int> xs = random_coordinates( click_count, 1920, 1u );
+    std::vector<int> ys = random_coordinates( click_count, 1080, 2u );
+
+    cs225::EventDispatcher & dispatcher = cs225::EventDispatcher::get_instance();
+    ClickCounter counter;
+    dispatcher.subscribe( counter, cs225::type_of<ClickEvent>() );
+
+    while( state.keep_running() )
+    {
+        for( std::size_t i = 0; i < click_count; ++i )
+            cs225::trigger_event( ClickEvent( xs[i], ys[i] ) );
+    }
+    do_not_optimize( counter.inside );
+
+    dispatcher.clear();
+}
+
+// clicks are appended to a columnar stream and handled a block at a time
+BENCHMARK( "1M clicks: columnar stream" )
+{
+    std::vector<int> xs = random_coordinates( click_count, 1920, 1u );
+    std::vector<int> ys = random_coordinates( click_count, 1080, 2u );
+
+    cs225::ColumnarStream<ClickEvent> clicks;
+    ColumnarClickCounter counter;
+    clicks.subscribe( counter );
+
+    while( state.keep_running() )
+    {
+        for( std::size_t i = 0; i < click_count; ++i )
+            clicks.append( xs[i], ys[i] );
+        clicks.flush();
+    }
+    do_not_optimize( counter.inside );
+}
+
+/*********************************************************************
+ *                       Predicate filtering                         *
+ *********************************************************************/
+
+// each listener wants the clicks inside its own rectangle of the screen
+struct Rectangle
+{
+    std::int32_t left, right, top, bottom;
+
+    bool contains( int x, int y ) const { return x >= left && x <= right && y >= top && y <= bottom; }
+};
+
+const Rectangle screen_regions[] =
+{
+    { 0, 479, 0, 539 }, { 480, 959, 0, 539 }, { 960, 1439, 0, 539 }, { 1440, 1919, 0, 539 },
+    { 0, 479, 540, 1079 }, { 480, 959, 540, 1079 }, { 960, 1439, 540, 1079 }, { 1440, 1919, 540, 1079 }
+};
+const std::size_t region_count = sizeof(screen_regions) / sizeof(screen_regions[0]);
+
+// filters the clicks one at a time inside the handler
+struct RegionListener : public cs225::Listener
+{
+    RegionListener( const Rectangle & r ) : region(r), inside(0u) {}
+
+    virtual void handle_event( const cs225::Event & event )
+    {
+        const ClickEvent & click = static_cast<const ClickEvent &>( event );
+        if( region.contains( click.x, click.y ) )
+            inside++;
+    }
+    Rectangle region;
+    unsigned long inside;
+};
+
+// same, but over whole blocks
+struct ColumnarRegionListener : public cs225::ColumnarListener<ClickEvent>
+{
+    ColumnarRegionListener( const Rectangle & r ) : region(r), inside(0u) {}
+
+    virtual void handle_block( const view_type & clicks )
+    {
+        const int * x = clicks.column<0>();
+        const int * y = clicks.column<1>();
+        for( std::size_t i = 0; i < clicks.size(); ++i )
+        {
+            if( region.contains( x[i], y[i] ) )
+                inside++;
+        }
+    }
+    Rectangle region;
+    unsigned long inside;
+};
+
+// lets the stream filter the blocks, only counts the selected clicks
+struct SelectedClickCounter : public cs225::ColumnarListener<ClickEvent>
+{
+    SelectedClickCounter() : inside(0u) {}
+
+    virtual void handle_block( const view_type & clicks ) { inside += clicks.size(); }
+    virtual void handle_selection( const view_type &, const cs225::SelectionMask & selected ) { inside += selected.count(); }
+    unsigned long inside;
+};
+
+BENCHMARK( "1M clicks to 8 region listeners: per-event filtering in handle_event" )
+{
+    std::vector<int> xs = random_coordinates( click_count, 1920, 1u );
+    std::vector<int> ys = random_coordinates( click_count, 1080, 2u );
+
+    cs225::EventDispatcher & dispatcher = cs225::EventDispatcher::get_instance();
+    std::vector<RegionListener> listeners( screen_regions, screen_regions + region_count );
+    for( RegionListener & listener : listeners )
+        dispatcher.subscribe( listener, cs225::type_of<ClickEvent>() );
+
+    while( state.keep_running() )
+    {
+        for( std::size_t i = 0; i < click_count; ++i )
+            cs225::trigger_event( ClickEvent( xs[i], ys[i] ) );
+    }
+    do_not_optimize( listeners[0].inside );
+
+    dispatcher.clear();
+}
+
+BENCHMARK( "1M clicks to 8 region listeners: per-event filtering in handle_block" )
+{
+    std::vector<int> xs = random_coordinates( click_count, 1920, 1u );
+    std::vector<int> ys = random_coordinates( click_count, 1080, 2u );
+
+    cs225::ColumnarStream<ClickEvent> clicks;
+    std::vector<ColumnarRegionListener> listeners( screen_regions, screen_regions + region_count );
+    for( ColumnarRegionListener & listener : listeners )
+        clicks.subscribe( listener );
+
+    while( state.keep_running() )
+    {
+        for( std::size_t i = 0; i < click_count; ++i )
+            clicks.append( xs[i], ys[i] );
+        clicks.flush();
+    }
+    do_not_optimize( listeners[0].inside );
+}
+
+inline void run_predicate_filtering( BenchmarkState & state, cs225::FilterKernel kernel )
+{
+    std::vector<int> xs = random_coordinates( click_count, 1920, 1u );
+    std::vector<int> ys = random_coordinates( click_count, 1080, 2u );
+
+    const cs225::FilterKernel original = cs225::get_filter_kernel();
+    cs225::set_filter_kernel( kernel );
+
+    cs225::ColumnarStream<ClickEvent> clicks;
+    std::vector<SelectedClickCounter> listeners( region_count );
+    for( std::size_t i = 0; i < region_count; ++i )
+    {
+        const Rectangle & r = screen_regions[i];
+        clicks.subscribe( listeners[i], cs225::Predicate().where( 0, r.left, r.right ).where( 1, r.top, r.bottom ) );
+    }
+
+    while( state.keep_running() )
+    {
+        for( std::size_t i = 0; i < click_count; ++i )
+            clicks.append( xs[i], ys[i] );
+        clicks.flush();
+    }
+    do_not_optimize( listeners[0].inside );
+
+    cs225::set_filter_kernel( original );
+}
+
+BENCHMARK( "1M clicks to 8 region listeners: predicates, scalar kernel" )
+{
+    run_predicate_filtering( state, cs225::FilterKernel::scalar );
+}
+
+BENCHMARK( "1M clicks to 8 region listeners: predicates, best kernel for this CPU" )
+{
+    run_predicate_filtering( state, cs225::is_supported( cs225::FilterKernel::avx2 ) ? cs225::FilterKernel::avx2
+                                  : cs225::is_supported( cs225::FilterKernel::sse2 ) ? cs225::FilterKernel::sse2
+                                  : cs225::FilterKernel::scalar );
+}
+
+// overload: two producer threads post faster than the dispatcher thread can handle
+
+struct WorkEvent : public cs225::Event
+{
+    WorkEvent( std::uint64_t v ) : value(v) {}
+    std::uint64_t value;
+};
+
+// spends some time on every event, so that the queue fills up
+struct SlowListener : public cs225::Listener
+{
+    SlowListener() : total(0u) {}
+    virtual void handle_event( const cs225::Event & event )
+    {
+        std::uint64_t value = static_cast<const WorkEvent &>( event ).value;
+        for( int i = 0; i < 200; ++i )
+            value = value * 6364136223846793005ull + 1442695040888963407ull;
+        total += value;
+    }
+    std::uint64_t total;
+};
+
+const std::size_t posts_per_producer = 2000u;
+
+inline void run_overload( BenchmarkState & state, const cs225::QueueLimit & limit )
+{
+    cs225::EventDispatcher & dispatcher = cs225::EventDispatcher::get_instance();
+    SlowListener listener;
+    dispatcher.subscribe( listener, cs225::type_of<WorkEvent>() );
+
+    cs225::QueueCounters counters;
+    while( state.keep_running() )
+    {
+        cs225::EventQueue queue( limit );
+        std::thread producers[2];
+        for( std::thread & producer : producers )
+            producer = std::thread( [&queue]()
+            {
+                for( std::size_t i = 0; i < posts_per_producer; ++i )
+                    queue.post( WorkEvent( i ) );
+            } );
+        std::thread closer( [&queue, &producers]()
+        {
+            for( std::thread & producer : producers )
+                producer.join();
+            queue.close();
+        } );
+        queue.pump_until_closed();
+        closer.join();
+        counters = queue.get_counters();
+    }
+    do_not_optimize( listener.total );
+    state.set_counter( "high_watermark", counters.high_watermark );
+    state.set_counter( "dropped", counters.dropped );
+    state.set_counter( "blocked", counters.blocked );
+
+    dispatcher.clear();
+}
+
+BENCHMARK( "2 producers x 2000 events to a slow consumer: unbounded" )
+{
+    run_overload( state, cs225::QueueLimit() );
+}
+
+BENCHMARK( "2 producers x 2000 events to a slow consumer: 64, block" )
+{
+    run_overload( state, cs225::QueueLimit( 64u, cs225::OverflowPolicy::block ) );
+}
+
+BENCHMARK( "2 producers x 2000 events to a slow consumer: 64, drop newest" )
+{
+    run_overload( state, cs225::QueueLimit( 64u, cs225::OverflowPolicy::drop_newest ) );
+}
+
+BENCHMARK( "2 producers x 2000 events to a slow consumer: 64, drop oldest" )
+{
+    run_overload( state, cs225::QueueLimit( 64u, cs225::OverflowPolicy::drop_oldest ) );
+}
+
+BENCHMARK( "2 producers x 2000 events to a slow consumer: 64, sample 1/16" )
+{
+    run_overload( state, cs225::QueueLimit( 64u, cs225::OverflowPolicy::sample, 16u ) );
+}
+
+// 100 event types that capture a snapshot when built, only 1 in 10 of them is listened to
+
+const std::size_t snapshot_type_count = 100u;
+
+template <std::size_t N>
+struct SnapshotEvent : public cs225::Event
+{
+    explicit SnapshotEvent( const std::vector<int> & state ) : snapshot(state) {}
+    std::vector<int> snapshot;
+};
+
+// triggers one event of each type from N on, eagerly or lazily
+template <std::size_t N, bool Lazy, bool Last = ( N == snapshot_type_count )>
+struct TriggerSnapshots
+{
+    static void run( const std::vector<int> & state )
+    {
+        if( Lazy )
+            cs225::trigger<SnapshotEvent<N>>( state );
+        else
+            cs225::trigger_event( SnapshotEvent<N>( state ) );
+        TriggerSnapshots<N + 1, Lazy>::run( state );
+    }
+};
+
+template <std::size_t N, bool Lazy>
+struct TriggerSnapshots<N, Lazy, true>
+{
+    static void run( const std::vector<int> & ) {}
+};
+
+template <std::size_t N, bool Last = ( N == snapshot_type_count )>
+struct SubscribeSnapshots
+{
+    static void run( cs225::Listener & listener )
+    {
+        if( N % 10 == 0 )
+            cs225::EventDispatcher::get_instance().subscribe( listener, cs225::type_of<SnapshotEvent<N>>() );
+        SubscribeSnapshots<N + 1>::run( listener );
+    }
+};
+
+template <std::size_t N>
+struct SubscribeSnapshots<N, true>
+{
+    static void run( cs225::Listener & ) {}
+};
+
+template <bool Lazy>
+void run_snapshots( BenchmarkState & state )
+{
+    CountingListener listener;
+    SubscribeSnapshots<0>::run( listener );
+    std::vector<int> snapshot( 64u, 1 );
+
+    while( state.keep_running() )
+        TriggerSnapshots<0, Lazy>::run( snapshot );
+    do_not_optimize( listener.count );
+
+    cs225::EventDispatcher::get_instance().clear();
+}
+
+BENCHMARK( "100 snapshot events, 10% listened to: trigger_event" )
+{
+    run_snapshots<false>( state );
+}
+
+BENCHMARK( "100 snapshot events, 10% listened to: trigger (lazy)" )
+{
+    run_snapshots<true>( state );
+}
+
+// fan-out of large events to consumers on 4 threads, each with its own queue
+
+struct LargeEvent : public cs225::Event
+{
+    explicit LargeEvent( int seed ) { for( int & value : payload ) value = seed; }
+    int payload[1024];
+};
+
+const std::size_t fan_out_consumers = 4u;
+const int fan_out_events = 1000;
+
+template <typename Handle>
+int read_payload( const Handle & event )
+{
+    const LargeEvent & large = static_cast<const LargeEvent &>( *event );
+    return large.payload[0] + large.payload[1023];
+}
+
+// Post( event, queues ) hands the event over to every consumer
+// returns the peak number of events queued (over all the queues) in the last round
+template <typename Handle, typename Post>
+std::size_t run_fan_out( BenchmarkState & state, Post post )
+{
+    std::size_t peak_queued = 0;
+    while( state.keep_running() )
+    {
+        std::vector<cs225::BoundedQueue<Handle>> queues( fan_out_consumers );
+        for( cs225::BoundedQueue<Handle> & queue : queues )
+            queue.set_limit( cs225::QueueLimit( 64u ) );
+
+        std::vector<std::thread> consumers;
+        for( cs225::BoundedQueue<Handle> & queue : queues )
+            consumers.push_back( std::thread( [&queue]()
+            {
+                Handle event;
+                int sum = 0;
+                while( queue.pop( event ) )
+                    sum += read_payload( event );
+                do_not_optimize( sum );
+            } ) );
+
+        for( int i = 0; i < fan_out_events; ++i )
+            post( LargeEvent( i ), queues );
+        for( cs225::BoundedQueue<Handle> & queue : queues )
+            queue.close();
+        for( std::thread & consumer : consumers )
+            consumer.join();
+
+        peak_queued = 0;
+        for( cs225::BoundedQueue<Handle> & queue : queues )
+            peak_queued += queue.get_counters().high_watermark;
+    }
+    return peak_queued;
+}
+
+BENCHMARK( "1000 4KB events to 4 consumer threads: copy per consumer" )
+{
+    typedef std::unique_ptr<cs225::Event> Handle;
+    std::size_t peak_queued = run_fan_out<Handle>( state, []( const LargeEvent & event, std::vector<cs225::BoundedQueue<Handle>> & queues )
+    {
+        for( cs225::BoundedQueue<Handle> & queue : queues )
+            queue.push( Handle( new LargeEvent( event ) ) );
+    } );
+    // every queued event is a copy of its own
+    state.set_counter( "peak_payload_bytes", peak_queued * sizeof(LargeEvent) );
+}
+
+BENCHMARK( "1000 4KB events to 4 consumer threads: shared pooled event" )
+{
+    run_fan_out<cs225::SharedEvent>( state, []( const LargeEvent & event, std::vector<cs225::BoundedQueue<cs225::SharedEvent>> & queues )
+    {
+        cs225::SharedEvent shared = cs225::make_shared_event<LargeEvent>( event );
+        for( cs225::BoundedQueue<cs225::SharedEvent> & queue : queues )
+            queue.push( shared );
+    } );
+    // the pool never shrinks, so its size is the peak
+    cs225::EventPool<LargeEvent> & pool = cs225::EventPool<LargeEvent>::get_instance();
+    state.set_counter( "peak_payload_bytes", pool.get_capacity() * pool.node_size() );
+}
+
+// 10M subscriptions: 100k listeners subscribed to each of 100 event types
+
+const std::size_t scale_type_count = 100u;
+const std::size_t scale_listener_count = 100000u;
+
+template <std::size_t N>
+struct ScaleEvent : public cs225::Event {};
+
+template <std::size_t N, bool Last = ( N == scale_type_count )>
+struct CollectScaleTypes
+{
+    static void run( std::vector<cs225::TypeInfo> & types )
+    {
+        types.push_back( cs225::type_of<ScaleEvent<N>>() );
+        CollectScaleTypes<N + 1>::run( types );
+    }
+};
+
+template <std::size_t N>
+struct CollectScaleTypes<N, true>
+{
+    static void run( std::vector<cs225::TypeInfo> & ) {}
+};
+
+// bytes currently allocated from the heap (0 where it can't be told)
+inline std::size_t heap_in_use()
+{
+    #if defined(__GLIBC__) && ( __GLIBC__ > 2 || __GLIBC_MINOR__ >= 33 )
+        return mallinfo2().uordblks;
+    #else
+        return 0u;
+    #endif
+}
+
+BENCHMARK( "10M subscriptions, dispatch of 100 types: map of SlotMap<Listener*> (previous layout)" )
+{
+    std::vector<cs225::TypeInfo> types;
+    CollectScaleTypes<0>::run( types );
+    std::vector<CountingListener> listeners( scale_listener_count );
+
+    const std::size_t heap_before = heap_in_use();
+    {
+        std::map<cs225::TypeInfo, cs225::SlotMap<cs225::Listener*>> subscribers;
+        for( CountingListener & listener : listeners )
+            for( const cs225::TypeInfo & type : types )
+                subscribers[type].insert( &listener );
+        const std::size_t bytes = heap_in_use() - heap_before;
+
+        ScaleEvent<0> event;
+        while( state.keep_running() )
+        {
+            for( const cs225::TypeInfo & type : types )
+            {
+                std::map<cs225::TypeInfo, cs225::SlotMap<cs225::Listener*>>::iterator found_it = subscribers.find( type );
+                for( cs225::Listener * listener : found_it->second )
+                    if( listener )
+                        listener->handle_event( event );
+            }
+        }
+        state.set_counter( "bytes_per_subscription", static_cast<double>( bytes ) / ( types.size() * listeners.size() ) );
+    }
+    do_not_optimize( listeners[0].count );
+}
+
+BENCHMARK( "10M subscriptions, dispatch of 100 types: event dispatcher (compact lists)" )
+{
+    cs225::EventDispatcher & dispatcher = cs225::EventDispatcher::get_instance();
+    std::vector<cs225::TypeInfo> types;
+    CollectScaleTypes<0>::run( types );
+    std::vector<CountingListener> listeners( scale_listener_count );
+
+    for( CountingListener & listener : listeners )
+        for( const cs225::TypeInfo & type : types )
+            dispatcher.subscribe( listener, type );
+    // clear empties the lists without freeing them, so the usage is taken from the dispatcher
+    // (not from the heap) and without the growth slack, which depends on earlier runs
+    dispatcher.shrink_to_fit();
+    const double subscriptions = static_cast<double>( types.size() * listeners.size() );
+    state.set_counter( "bytes_per_subscription", dispatcher.get_memory_usage().bytes / subscriptions );
+
+    ScaleEvent<0> event;
+    while( state.keep_running() )
+    {
+        for( const cs225::TypeInfo & type : types )
+            dispatcher.trigger_event( event, type );
+    }
+    do_not_optimize( listeners[0].count );
+
+    dispatcher.clear();
+}
+
+// 100 tick systems in 10 layers of 10: every layer consumes what the previous one produced
+
+const int layer_count = 10;
+const int systems_per_layer = 10;
+
+template <int L>
+struct LayerEvent : public cs225::Event
+{
+    explicit LayerEvent( std::uint64_t v ) : value(v) {}
+    std::uint64_t value;
+};
+
+// some arithmetic per event, standing in for game logic
+inline std::uint64_t simulate( std::uint64_t value )
+{
+    for( int i = 0; i < 2000; ++i )
+        value = value * 6364136223846793005ull + 1442695040888963407ull;
+    return value;
+}
+
+template <int L>
+struct LayerSystem : public cs225::TickSystem
+{
+    explicit LayerSystem( std::uint64_t s ) : seed(s) {}
+    virtual void update( cs225::TickContext & context )
+    {
+        std::uint64_t value = seed;
+        context.for_each<LayerEvent<L - 1>>( [&value]( const LayerEvent<L - 1> & event ) { value = simulate( value ^ event.value ); } );
+        context.emit<LayerEvent<L>>( value );
+    }
+    std::uint64_t seed;
+};
+
+template <>
+struct LayerSystem<0> : public cs225::TickSystem
+{
+    explicit LayerSystem( std::uint64_t s ) : seed(s) {}
+    virtual void update( cs225::TickContext & context )
+    {
+        seed = simulate( seed );
+        context.emit<LayerEvent<0>>( seed );
+    }
+    std::uint64_t seed;
+};
+
+template <int L, bool Last = ( L == layer_count )>
+struct LayerBuilder
+{
+    static void run( cs225::TickScheduler & scheduler, std::vector<std::unique_ptr<cs225::TickSystem>> & systems )
+    {
+        std::vector<cs225::TypeInfo> consumes;
+        if( L > 0 )
+            consumes.push_back( cs225::type_of<LayerEvent<( L > 0 ? L - 1 : 0 )>>() );
+        for( int i = 0; i < systems_per_layer; ++i )
+        {
+            systems.emplace_back( new LayerSystem<L>( L * systems_per_layer + i ) );
+            scheduler.add_system( *systems.back(), consumes, { cs225::type_of<LayerEvent<L>>() } );
+        }
+        LayerBuilder<L + 1>::run( scheduler, systems );
+    }
+};
+
+template <int L>
+struct LayerBuilder<L, true>
+{
+    static void run( cs225::TickScheduler &, std::vector<std::unique_ptr<cs225::TickSystem>> & ) {}
+};
+
+inline void run_layers( BenchmarkState & state, std::size_t threads )
+{
+    cs225::TickScheduler scheduler( threads );
+    std::vector<std::unique_ptr<cs225::TickSystem>> systems;
+    LayerBuilder<0>::run( scheduler, systems );
+
+    while( state.keep_running() )
+        scheduler.tick();
+    state.set_counter( "threads", scheduler.get_thread_count() );
+}
+
+BENCHMARK( "tick of 100 systems in 10 layers: 1 thread" )
+{
+    run_layers( state, 1u );
+}
+
+BENCHMARK( "tick of 100 systems in 10 layers: 2 threads" )
+{
+    run_layers( state, 2u );
+}
+
+BENCHMARK( "tick of 100 systems in 10 layers: 4 threads" )
+{
+    run_layers( state, 4u );
+}
+
+BENCHMARK( "tick of 100 systems in 10 layers: one thread per core" )
+{
+    run_layers( state, 0u );
+}
+
+// the cost of the slow-handler watchdog while a budget is set (fast handlers are only timed as a whole)
+
+inline void run_watched_fan_out( BenchmarkState & state, const cs225::LatencyBudget & budget )
+{
+    const std::size_t listener_count = 1000;
+
+    cs225::EventDispatcher & dispatcher = cs225::EventDispatcher::get_instance();
+    dispatcher.set_latency_budget( budget );
+    std::vector<CountingListener> listeners( listener_count );
+    for( CountingListener & listener : listeners )
+        dispatcher.subscribe( listener, cs225::type_of<ChurnEvent>() );
+
+    while( state.keep_running() )
+        cs225::trigger_event( ChurnEvent() );
+    do_not_optimize( listeners[0].count );
+    state.set_counter( "slow handlers", dispatcher.get_slow_handlers().get_total() );
+
+    dispatcher.set_latency_budget( cs225::LatencyBudget() );
+    dispatcher.get_slow_handlers().clear();
+    dispatcher.clear();
+}
+
+BENCHMARK( "dispatch fan-out to 1k subscribers: watchdog off" )
+{
+    run_watched_fan_out( state, cs225::LatencyBudget() );
+}
+
+BENCHMARK( "dispatch fan-out to 1k subscribers: watchdog on (1ms per listener, 10ms per dispatch)" )
+{
+    run_watched_fan_out( state, cs225::LatencyBudget( std::chrono::milliseconds( 1 ), std::chrono::milliseconds( 10 ) ) );
+}
+
+// routing 100k topics ("site<0-99>/room<0-99>/sensor<0-9>"): every 10th topic has an exact
+// subscriber, and a few wildcard patterns match about 2% of the topics
+
+const int topic_sites = 100;
+const int topic_rooms = 100;
+const int topic_sensors = 10;
+
+inline std::string topic_name( int site, int room, int sensor )
+{
+    return "site" + std::to_string( site ) + "/room" + std::to_string( room ) + "/sensor" + std::to_string( sensor );
+}
+
+const char * const topic_patterns[] = { "site7/#", "*/room3/*", "site42/*/sensor5", "#" };
+
+// string routing: exact subscribers in a hash map by name, patterns matched level by level
+inline bool pattern_matches( const std::string & pattern, const std::string & name )
+{
+    std::size_t p = 0, n = 0;
+    while( true )
+    {
+        std::size_t p_end = pattern.find( '/', p );
+        std::size_t n_end = name.find( '/', n );
+        if( p_end == std::string::npos ) p_end = pattern.size();
+        if( n_end == std::string::npos ) n_end = name.size();
+        if( pattern.compare( p, p_end - p, "#" ) == 0 )
+            return true;
+        if( pattern.compare( p, p_end - p, "*" ) != 0 && pattern.compare( p, p_end - p, name, n, n_end - n ) != 0 )
+            return false;
+        if( p_end == pattern.size() || n_end == name.size() )
+            return p_end == pattern.size() && n_end == name.size();
+        p = p_end + 1;
+        n = n_end + 1;
+    }
+}
+
+BENCHMARK( "publish to each of 100k topics: string names, hash map + pattern matching" )
+{
+    std::vector<std::string> names;
+    std::unordered_map<std::string, std::vector<cs225::Listener*>> exact;
+    std::vector<CountingListener> listeners( 10000u + 4u );
+    for( int site = 0; site < topic_sites; ++site )
+        for( int room = 0; room < topic_rooms; ++room )
+            for( int sensor = 0; sensor < topic_sensors; ++sensor )
+            {
+                names.push_back( topic_name( site, room, sensor ) );
+                if( names.size() % 10 == 0 )
+                    exact[names.back()].push_back( &listeners[names.size() / 10 - 1] );
+            }
+    std::vector<std::pair<std::string, cs225::Listener*>> patterns;
+    for( std::size_t i = 0; i < 4; ++i )
+        patterns.emplace_back( topic_patterns[i], &listeners[10000 + i] );
+
+    while( state.keep_running() )
+    {
+        for( const std::string & name : names )
+        {
+            const cs225::TopicEvent event( 1u );
+            auto found_it = exact.find( name );
+            if( found_it != exact.end() )
+                for( cs225::Listener * listener : found_it->second )
+                    listener->handle_event( event );
+            for( const std::pair<std::string, cs225::Listener*> & pattern : patterns )
+                if( pattern_matches( pattern.first, name ) )
+                    pattern.second->handle_event( event );
+        }
+    }
+    do_not_optimize( listeners[0].count );
+    state.set_counter( "topics", static_cast<double>( topic_sites * topic_rooms * topic_sensors ) );
+}
+
+BENCHMARK( "publish to each of 100k topics: interned topic channels" )
+{
+    cs225::TopicChannels & channels = cs225::TopicChannels::get_instance();
+    std::vector<cs225::TopicId> topics;
+    std::vector<CountingListener> listeners( 10000u + 4u );
+    for( int site = 0; site < topic_sites; ++site )
+        for( int room = 0; room < topic_rooms; ++room )
+            for( int sensor = 0; sensor < topic_sensors; ++sensor )
+            {
+                topics.push_back( channels.intern( topic_name( site, room, sensor ) ) );
+                if( topics.size() % 10 == 0 )
+                    channels.subscribe( listeners[topics.size() / 10 - 1], topics.back() );
+            }
+    for( std::size_t i = 0; i < 4; ++i )
+        channels.subscribe( listeners[10000 + i], topic_patterns[i] );
+    // the first publish of each topic works out its wildcard matches
+    for( cs225::TopicId topic : topics )
+        channels.has_subscribers( topic );
+
+    while( state.keep_running() )
+    {
+        for( cs225::TopicId topic : topics )
+            channels.publish( cs225::TopicEvent( topic ) );
+    }
+    do_not_optimize( listeners[0].count );
+    state.set_counter( "topics", static_cast<double>( topic_sites * topic_rooms * topic_sensors ) );
+
+    channels.clear();
+}
+
+// tearing down 100k listeners subscribed to 20 types each (the subscriptions are made
+// again in every iteration, at the same cost in all three)
+
+const std::size_t teardown_listeners = 100000;
+const int teardown_types = 20;
+
+enum class Teardown { tokens, by_type, all };
+
+inline void run_teardown( BenchmarkState & state, Teardown teardown )
+{
+    cs225::EventDispatcher & dispatcher = cs225::EventDispatcher::get_instance();
+    std::vector<cs225::TypeInfo> types;
+    KeyTypes<teardown_types>::fill( types );
+    std::vector<NullListener> listeners( teardown_listeners );
+    std::vector<cs225::SubscriptionToken> tokens;
+    tokens.reserve( teardown_listeners * teardown_types );
+
+    while( state.keep_running() )
+    {
+        for( NullListener & listener : listeners )
+            for( const cs225::TypeInfo & type : types )
+                tokens.push_back( dispatcher.subscribe( listener, type ) );
+
+        switch( teardown )
+        {
+            case Teardown::tokens:
+                for( const cs225::SubscriptionToken & token : tokens )
+                    dispatcher.unsubscribe( token );
+                break;
+            case Teardown::by_type:
+                for( NullListener & listener : listeners )
+                    for( const cs225::TypeInfo & type : types )
+                        dispatcher.unsubscribe( listener, type );
+                break;
+            case Teardown::all:
+                for( NullListener & listener : listeners )
+                    dispatcher.unsubscribe_all( listener );
+                break;
+        }
+        tokens.clear();
+    }
+    state.set_counter( "subscriptions left", static_cast<double>( dispatcher.get_memory_usage().subscriptions ) );
+
+    dispatcher.clear();
+}
+
+BENCHMARK( "100k listeners x 20 types, subscribe + teardown: tokens kept by the caller" )
+{
+    run_teardown( state, Teardown::tokens );
+}
+
+BENCHMARK( "100k listeners x 20 types, subscribe + teardown: unsubscribe each type" )
+{
+    run_teardown( state, Teardown::by_type );
+}
+
+BENCHMARK( "100k listeners x 20 types, subscribe + teardown: unsubscribe_all" )
+{
+    run_teardown( state, Teardown::all );
+}
+
+// a 5-stage chain (filter, map, filter, map, window of 8 summed) over 1k sensor readings:
+// as a cascade of listeners that re-trigger a derived event at each stage, and as a stream
+
+const int chain_readings = 1000;
+
+struct SensorReading : public cs225::Event
+{
+    explicit SensorReading( int v ) : value(v) {}
+    int value;
+};
+
+template <int Stage>
+struct StageEvent : public cs225::Event
+{
+    explicit StageEvent( int v ) : value(v) {}
+    int value;
+};
+
+struct EvenReadings : public cs225::Listener
+{
+    virtual void handle_event( const cs225::Event & event )
+    {
+        int value = static_cast<const SensorReading &>( event ).value;
+        if( value % 2 == 0 )
+            cs225::trigger_event( StageEvent<1>( value ) );
+    }
+};
+
+struct ScaledReadings : public cs225::Listener
+{
+    virtual void handle_event( const cs225::Event & event )
+    {
+        cs225::trigger_event( StageEvent<2>( static_cast<const StageEvent<1> &>( event ).value * 3 ) );
+    }
+};
+
+struct NonFiveReadings : public cs225::Listener
+{
+    virtual void handle_event( const cs225::Event & event )
+    {
+        int value = static_cast<const StageEvent<2> &>( event ).value;
+        if( value % 5 != 0 )
+            cs225::trigger_event( StageEvent<3>( value ) );
+    }
+};
+
+struct ShiftedReadings : public cs225::Listener
+{
+    virtual void handle_event( const cs225::Event & event )
+    {
+        cs225::trigger_event( StageEvent<4>( static_cast<const StageEvent<3> &>( event ).value + 1 ) );
+    }
+};
+
+struct WindowSums : public cs225::Listener
+{
+    WindowSums() : sum(0), count(0), total(0) {}
+    virtual void handle_event( const cs225::Event & event )
+    {
+        sum += static_cast<const StageEvent<4> &>( event ).value;
+        if( ++count < 8 )
+            return;
+        total += sum;
+        sum = 0;
+        count = 0;
+    }
+    int sum;
+    int count;
+    std::int64_t total;
+};
+
+BENCHMARK( "5-stage chain over 1k events: listener cascade" )
+{
+    cs225::EventDispatcher & dispatcher = cs225::EventDispatcher::get_instance();
+    EvenReadings even;
+    ScaledReadings scaled;
+    NonFiveReadings non_five;
+    ShiftedReadings shifted;
+    WindowSums sums;
+    dispatcher.subscribe( even, cs225::type_of<SensorReading>() );
+    dispatcher.subscribe( scaled, cs225::type_of<StageEvent<1>>() );
+    dispatcher.subscribe( non_five, cs225::type_of<StageEvent<2>>() );
+    dispatcher.subscribe( shifted, cs225::type_of<StageEvent<3>>() );
+    dispatcher.subscribe( sums, cs225::type_of<StageEvent<4>>() );
+
+    while( state.keep_running() )
+    {
+        for( int value = 0; value < chain_readings; ++value )
+            cs225::trigger_event( SensorReading( value ) );
+    }
+    do_not_optimize( sums.total );
+
+    dispatcher.clear();
+}
+
+BENCHMARK( "5-stage chain over 1k events: fused stream" )
+{
+    cs225::EventDispatcher & dispatcher = cs225::EventDispatcher::get_instance();
+    std::int64_t total = 0;
+    cs225::StreamSubscription subscription = cs225::stream<SensorReading>()
+        .filter( []( const SensorReading & reading ) { return reading.value % 2 == 0; } )
+        .map( []( const SensorReading & reading ) { return reading.value * 3; } )
+        .filter( []( int value ) { return value % 5 != 0; } )
+        .map( []( int value ) { return value + 1; } )
+        .window( 8u )
+        .subscribe( [&total]( const std::vector<int> & values )
+        {
+            for( int value : values )
+                total += value;
+        } );
+
+    while( state.keep_running() )
+    {
+        for( int value = 0; value < chain_readings; ++value )
+            cs225::trigger_event( SensorReading( value ) );
+    }
+    do_not_optimize( total );
+
+    subscription.reset();
+    dispatcher.clear();
+}
+
+// steady-state dispatch and startup, with the dispatch table left incremental or frozen
+
+enum class Registration { incremental, frozen };
+
+template <typename L>
+inline void register_all( cs225::EventDispatcher & dispatcher, std::vector<L> & listeners,
+                          const std::vector<cs225::TypeInfo> & types, Registration registration,
+                          std::vector<cs225::SubscriptionToken> & tokens )
+{
+    for( L & listener : listeners )
+        for( const cs225::TypeInfo & type : types )
+            tokens.push_back( dispatcher.subscribe( listener, type ) );
+    if( registration == Registration::frozen )
+        dispatcher.freeze();
+}
+
+const int frozen_dispatch_listeners = 16;
+
+inline void run_steady_dispatch( BenchmarkState & state, Registration registration )
+{
+    cs225::EventDispatcher & dispatcher = cs225::EventDispatcher::get_instance();
+    std::vector<cs225::TypeInfo> types;
+    KeyTypes<64>::fill( types );
+    std::vector<CountingListener> listeners( frozen_dispatch_listeners );
+    std::vector<cs225::SubscriptionToken> tokens;
+    register_all( dispatcher, listeners, types, registration, tokens );
+
+    ScaleEvent<0> event;
+    while( state.keep_running() )
+    {
+        for( int round = 0; round < 100; ++round )
+            for( const cs225::TypeInfo & type : types )
+                dispatcher.trigger_event( event, type );
+    }
+    do_not_optimize( listeners[0].count );
+
+    dispatcher.clear();
+}
+
+BENCHMARK( "6400 dispatches of 64 types to 16 listeners: incremental table" )
+{
+    run_steady_dispatch( state, Registration::incremental );
+}
+
+BENCHMARK( "6400 dispatches of 64 types to 16 listeners: frozen table" )
+{
+    run_steady_dispatch( state, Registration::frozen );
+}
+
+// startup: 100k listeners subscribed to 20 types each, then cleared
+
+inline void run_startup( BenchmarkState & state, Registration registration )
+{
+    cs225::EventDispatcher & dispatcher = cs225::EventDispatcher::get_instance();
+    std::vector<cs225::TypeInfo> types;
+    KeyTypes<teardown_types>::fill( types );
+    std::vector<NullListener> listeners( teardown_listeners );
+    std::vector<cs225::SubscriptionToken> tokens;
+    tokens.reserve( listeners.size() * types.size() );
+
+    while( state.keep_running() )
+    {
+        tokens.clear();
+        register_all( dispatcher, listeners, types, registration, tokens );
+        dispatcher.clear();
+    }
+}
+
+BENCHMARK( "startup, 100k listeners x 20 types: incremental subscribe" )
+{
+    run_startup( state, Registration::incremental );
+}
+
+BENCHMARK( "startup, 100k listeners x 20 types: subscribe + freeze" )
+{
+    run_startup( state, Registration::frozen );
+}
+
+// worker placement: 16 producers emit 1k 64-byte events per tick, 16 consumers read all
+// of them, on one thread per core, pinned or not (the counters tell the host topology)
+
+const int placed_producers = 16;
+const int placed_consumers = 16;
+const int placed_events = 1000;
+
+struct PlacedEvent : public cs225::Event
+{
+    explicit PlacedEvent( std::uint64_t v ) { for( std::uint64_t & value : values ) value = v++; }
+    std::uint64_t values[8];
+};
+
+struct PlacedProducer : public cs225::TickSystem
+{
+    virtual void update( cs225::TickContext & context )
+    {
+        for( int i = 0; i < placed_events; ++i )
+            context.emit<PlacedEvent>( context.get_tick() + static_cast<std::uint64_t>( i ) );
+    }
+};
+
+struct PlacedConsumer : public cs225::TickSystem
+{
+    PlacedConsumer() : sum(0) {}
+    virtual void update( cs225::TickContext & context )
+    {
+        context.for_each<PlacedEvent>( [this]( const PlacedEvent & event )
+        {
+            for( std::uint64_t value : event.values )
+                sum += value;
+        } );
+    }
+    std::uint64_t sum;
+};
+
+inline void run_placed_ticks( BenchmarkState & state, const cs225::ThreadPlacement & placement )
+{
+    cs225::TickScheduler scheduler( 0u, placement );
+    std::vector<PlacedProducer> producers( placed_producers );
+    std::vector<PlacedConsumer> consumers( placed_consumers );
+    for( PlacedProducer & producer : producers )
+        scheduler.add_system( producer, {}, { cs225::type_of<PlacedEvent>() } );
+    for( PlacedConsumer & consumer : consumers )
+        scheduler.add_system( consumer, { cs225::type_of<PlacedEvent>() }, {} );
+
+    while( state.keep_running() )
+        scheduler.tick();
+    do_not_optimize( consumers[0].sum );
+
+    std::size_t pinned = 0;
+    for( int core : scheduler.get_worker_cores() )
+        pinned += core != cs225::CpuTopology::no_core;
+    state.set_counter( "threads", scheduler.get_thread_count() );
+    state.set_counter( "pinned_workers", pinned );
+    state.set_counter( "nodes", cs225::CpuTopology::get_host().get_node_count() );
+}
+
+BENCHMARK( "tick of 16k events, 16 producers to 16 consumers, one thread per core: unpinned" )
+{
+    run_placed_ticks( state, cs225::ThreadPlacement() );
+}
+
+BENCHMARK( "tick of 16k events, 16 producers to 16 consumers, one thread per core: compact" )
+{
+    run_placed_ticks( state, cs225::PlacementPolicy::compact );
+}
+
+BENCHMARK( "tick of 16k events, 16 producers to 16 consumers, one thread per core: scatter" )
+{
+    run_placed_ticks( state, cs225::PlacementPolicy::scatter );
+}
+
+} // namespace Benchmarks
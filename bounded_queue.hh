@@ -0,0 +1,329 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <map>
+#include <mutex>
+
+namespace cs225
+{
+    // what a full queue does with a new element
+    enum class OverflowPolicy
+    {
+        block,          // the producer waits until there is room
+        drop_newest,    // the new element is discarded
+        drop_oldest,    // the oldest element is discarded to make room
+        sample          // one in every `sample_interval` overflowing elements replaces the oldest one, the rest are discarded
+    };
+
+    struct QueueLimit
+    {
+        QueueLimit(std::size_t max_size = std::numeric_limits<std::size_t>::max(),
+                   OverflowPolicy on_overflow = OverflowPolicy::block, std::size_t interval = 16)
+            : capacity{max_size}, policy{on_overflow}, sample_interval{interval ? interval : 1}
+        {}
+
+        std::size_t capacity;
+        OverflowPolicy policy;
+        std::size_t sample_interval;
+    };
+
+    struct QueueCounters
+    {
+        QueueCounters() : pushed{0}, popped{0}, dropped{0}, blocked{0}, high_watermark{0}
+        {}
+
+        std::uint64_t pushed;           // elements accepted
+        std::uint64_t popped;
+        std::uint64_t dropped;          // elements discarded by an overflow policy (new or old)
+        std::uint64_t blocked;          // pushes that had to wait for room
+        std::size_t high_watermark;     // maximum number of queued elements
+    };
+
+    enum class PushResult
+    {
+        accepted,
+        dropped,        // discarded by an overflow policy, or the queue is closed
+        would_block     // only from try_push: the queue is full and its policy is to block
+    };
+
+    // the default classifier: every element belongs to the same class
+    struct SingleClass
+    {
+        template <typename T>
+        std::uint64_t operator()(const T&) const { return 0; }
+    };
+
+    // thread-safe FIFO queue with a capacity limit and an overflow policy, so that memory stays
+    // bounded when consumers fall behind; elements can also be grouped in classes (by the
+    // Classify functor) with their own limits, e.g. one per event type
+    template <typename T, typename Classify = SingleClass>
+    class BoundedQueue
+    {
+    public:
+        explicit BoundedQueue(const QueueLimit& queue_limit = QueueLimit{})
+            : limit(queue_limit), overflows{0}, closed{false}
+        {}
+
+        void set_limit(const QueueLimit& queue_limit)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            limit = queue_limit;
+            not_full.notify_all();
+        }
+
+        // limits the elements of one class (on top of the limit of the whole queue)
+        void set_class_limit(std::uint64_t key, const QueueLimit& class_limit)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            // start tracking the classes of the elements already queued
+            if (classes.empty())
+            {
+                for (const Entry& entry : elements)
+                    classes[entry.key].count++;
+            }
+            ClassState& state = classes[key];
+            state.limit = class_limit;
+            state.limited = true;
+            not_full.notify_all();
+        }
+
+        // returns false if the element was discarded (or the queue is closed)
+        bool push(T value)
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            return admit(value, guard, true) == PushResult::accepted;
+        }
+
+        // like push, but never waits: the element is left untouched if the queue would block
+        PushResult try_push(T& value)
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            return admit(value, guard, false);
+        }
+
+        bool try_pop(T& out)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (elements.empty())
+                return false;
+            take_front(out);
+            return true;
+        }
+
+        // waits for an element; returns false once the queue is closed and empty
+        bool pop(T& out)
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            not_empty.wait(guard, [this]() { return !elements.empty() || closed; });
+            if (elements.empty())
+                return false;
+            take_front(out);
+            return true;
+        }
+
+        // discards every queued element (not counted as dropped)
+        void clear()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (const Entry& entry : elements)
+                forget(entry.key);
+            elements.clear();
+            not_full.notify_all();
+        }
+
+        // wakes up every waiting producer and consumer; later pushes are rejected
+        void close()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            closed = true;
+            not_full.notify_all();
+            not_empty.notify_all();
+        }
+
+        std::size_t size() const
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return elements.size();
+        }
+        bool full() const
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return elements.size() >= limit.capacity;
+        }
+        QueueCounters get_counters() const
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return counters;
+        }
+        QueueCounters get_class_counters(std::uint64_t key) const
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto found_it = classes.find(key);
+            return found_it != classes.end() ? found_it->second.counters : QueueCounters{};
+        }
+    private:
+        struct ClassState
+        {
+            ClassState() : count{0}, overflows{0}, limited{false}
+            {}
+
+            QueueLimit limit;
+            QueueCounters counters;
+            std::size_t count;
+            std::size_t overflows;
+            bool limited;
+        };
+
+        struct Entry
+        {
+            T value;
+            std::uint64_t key;
+        };
+
+        PushResult admit(T& value, std::unique_lock<std::mutex>& guard, bool may_wait)
+        {
+            const std::uint64_t key = classify(value);
+            bool waited = false;
+            while (!closed)
+            {
+                ClassState* state = find_limited(key);
+                bool class_full = state && state->count >= state->limit.capacity;
+                if (!class_full && elements.size() < limit.capacity)
+                {
+                    if (waited)
+                        count_blocked(state);
+                    insert(std::move(value), key);
+                    return PushResult::accepted;
+                }
+
+                // the class limit takes precedence when both are reached
+                const QueueLimit& reached = class_full ? state->limit : limit;
+                switch (reached.policy)
+                {
+                    case OverflowPolicy::block:
+                        if (!may_wait)
+                            return PushResult::would_block;
+                        waited = true;
+                        not_full.wait(guard);
+                        break;
+                    case OverflowPolicy::drop_newest:
+                        count_dropped(state);
+                        return PushResult::dropped;
+                    case OverflowPolicy::drop_oldest:
+                        if (!drop_oldest(class_full, key))
+                        {
+                            // nothing to make room with (zero capacity)
+                            count_dropped(state);
+                            return PushResult::dropped;
+                        }
+                        break;
+                    case OverflowPolicy::sample:
+                        if (++(class_full ? state->overflows : overflows) % reached.sample_interval != 0
+                            || !drop_oldest(class_full, key))
+                        {
+                            count_dropped(state);
+                            return PushResult::dropped;
+                        }
+                        break;
+                }
+            }
+            return PushResult::dropped;
+        }
+
+        // classes are only tracked once some class has a limit
+        ClassState* find_limited(std::uint64_t key)
+        {
+            if (classes.empty())
+                return nullptr;
+            auto found_it = classes.find(key);
+            return found_it != classes.end() && found_it->second.limited ? &found_it->second : nullptr;
+        }
+        ClassState* find_tracked(std::uint64_t key)
+        {
+            if (classes.empty())
+                return nullptr;
+            return &classes[key];
+        }
+
+        void insert(T&& value, std::uint64_t key)
+        {
+            elements.push_back(Entry{std::move(value), key});
+            counters.pushed++;
+            if (elements.size() > counters.high_watermark)
+                counters.high_watermark = elements.size();
+
+            if (ClassState* state = find_tracked(key))
+            {
+                state->counters.pushed++;
+                if (++state->count > state->counters.high_watermark)
+                    state->counters.high_watermark = state->count;
+            }
+            not_empty.notify_one();
+        }
+
+        void take_front(T& out)
+        {
+            out = std::move(elements.front().value);
+            if (ClassState* state = forget(elements.front().key))
+                state->counters.popped++;
+            elements.pop_front();
+            counters.popped++;
+            not_full.notify_all();
+        }
+
+        // discards the oldest element of the class (or of the whole queue)
+        // returns false if there is none
+        bool drop_oldest(bool of_class, std::uint64_t key)
+        {
+            auto victim = elements.begin();
+            if (of_class)
+            {
+                while (victim != elements.end() && victim->key != key)
+                    ++victim;
+            }
+            if (victim == elements.end())
+                return false;
+
+            count_dropped(forget(victim->key));
+            elements.erase(victim);
+            return true;
+        }
+
+        // an element of the class is leaving the queue
+        ClassState* forget(std::uint64_t key)
+        {
+            ClassState* state = find_tracked(key);
+            if (state)
+                state->count--;
+            return state;
+        }
+
+        void count_dropped(ClassState* state)
+        {
+            counters.dropped++;
+            if (state)
+                state->counters.dropped++;
+        }
+        void count_blocked(ClassState* state)
+        {
+            counters.blocked++;
+            if (state)
+                state->counters.blocked++;
+        }
+
+        mutable std::mutex lock;
+        std::condition_variable not_full;
+        std::condition_variable not_empty;
+        std::deque<Entry> elements;
+        QueueLimit limit;
+        QueueCounters counters;
+        std::size_t overflows;
+        std::map<std::uint64_t, ClassState> classes;
+        Classify classify;
+        bool closed;
+    };
+}
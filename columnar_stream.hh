@@ -0,0 +1,347 @@
+#pragma once
+
+#include "predicate_filter.hh"
+#include "slot_map.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace cs225
+{
+    // describes how an event type is split into columns
+    // event types opt in to columnar streams by specializing it, e.g.
+    //
+    //     template <> struct ColumnLayout<MouseClickedEvent>
+    //     {
+    //         using block_type = ColumnBlock<int, int>;   // x, y
+    //         static void append(block_type& block, const MouseClickedEvent& event)
+    //         {
+    //             block.append(event.position.x, event.position.y);
+    //         }
+    //     };
+    template <typename E>
+    struct ColumnLayout;
+
+    namespace detail
+    {
+        template <std::size_t I, typename Tuple>
+        void append_columns(Tuple&)
+        {}
+        template <std::size_t I, typename Tuple, typename T, typename... Rest>
+        void append_columns(Tuple& columns, const T& value, const Rest&... rest)
+        {
+            std::get<I>(columns).push_back(value);
+            append_columns<I + 1>(columns, rest...);
+        }
+
+        // applies f to every column
+        template <std::size_t I, std::size_t N>
+        struct ForEachColumn
+        {
+            template <typename Tuple, typename F>
+            static void apply(Tuple& columns, F f)
+            {
+                f(std::get<I>(columns));
+                ForEachColumn<I + 1, N>::apply(columns, f);
+            }
+        };
+        template <std::size_t N>
+        struct ForEachColumn<N, N>
+        {
+            template <typename Tuple, typename F>
+            static void apply(Tuple&, F)
+            {}
+        };
+
+        // runtime access to the columns of 32-bit integers, for predicate filtering
+        inline const std::int32_t* int32_data(const std::vector<std::int32_t>& column) { return column.data(); }
+        template <typename T>
+        const std::int32_t* int32_data(const std::vector<T>&) { return nullptr; }
+
+        template <std::size_t I, std::size_t N>
+        struct Int32Column
+        {
+            template <typename Tuple>
+            static const std::int32_t* get(const Tuple& columns, std::size_t index)
+            {
+                return index == I ? int32_data(std::get<I>(columns)) : Int32Column<I + 1, N>::get(columns, index);
+            }
+            template <typename Tuple>
+            static bool is_int32(std::size_t index)
+            {
+                using column = typename std::tuple_element<I, Tuple>::type;
+                return index == I ? std::is_same<column, std::vector<std::int32_t>>::value
+                                  : Int32Column<I + 1, N>::template is_int32<Tuple>(index);
+            }
+        };
+        template <std::size_t N>
+        struct Int32Column<N, N>
+        {
+            template <typename Tuple>
+            static const std::int32_t* get(const Tuple&, std::size_t) { return nullptr; }
+            template <typename Tuple>
+            static bool is_int32(std::size_t) { return false; }
+        };
+
+        struct ClearColumn
+        {
+            template <typename Column>
+            void operator()(Column& column) const { column.clear(); }
+        };
+        struct ReserveColumn
+        {
+            std::size_t capacity;
+            template <typename Column>
+            void operator()(Column& column) const { column.reserve(capacity); }
+        };
+    }
+
+    template <typename... Ts>
+    class ColumnView;
+
+    // a block of events stored as one contiguous array per field (struct of arrays)
+    template <typename... Ts>
+    class ColumnBlock
+    {
+    public:
+        using view_type = ColumnView<Ts...>;
+        template <std::size_t I>
+        using column_type = typename std::tuple_element<I, std::tuple<Ts...>>::type;
+
+        static const std::size_t column_count = sizeof...(Ts);
+
+        // one value per column
+        void append(const Ts&... values)
+        {
+            detail::append_columns<0>(columns, values...);
+        }
+
+        template <std::size_t I>
+        const std::vector<column_type<I>>& column() const
+        {
+            return std::get<I>(columns);
+        }
+
+        // data of column `index` if it holds 32-bit integers, null otherwise
+        const std::int32_t* int32_column(std::size_t index) const
+        {
+            return detail::Int32Column<0, column_count>::get(columns, index);
+        }
+        static bool is_int32_column(std::size_t index)
+        {
+            return detail::Int32Column<0, column_count>::template is_int32<std::tuple<std::vector<Ts>...>>(index);
+        }
+
+        std::size_t size() const { return std::get<0>(columns).size(); }
+        bool empty() const { return size() == 0; }
+
+        void clear()
+        {
+            detail::ForEachColumn<0, column_count>::apply(columns, detail::ClearColumn{});
+        }
+        void reserve(std::size_t capacity)
+        {
+            detail::ForEachColumn<0, column_count>::apply(columns, detail::ReserveColumn{capacity});
+        }
+
+        view_type view() const { return view_type{*this, 0, size()}; }
+        view_type view(std::size_t offset, std::size_t count) const { return view_type{*this, offset, count}; }
+    private:
+        std::tuple<std::vector<Ts>...> columns;
+    };
+
+    // read-only window over a range of rows of a ColumnBlock
+    // columns are exposed as plain pointers so that loops over them can be vectorized
+    template <typename... Ts>
+    class ColumnView
+    {
+    public:
+        using block_type = ColumnBlock<Ts...>;
+
+        ColumnView(const block_type& source, std::size_t first, std::size_t count)
+            : block{&source}, offset{first}, rows{count}
+        {}
+
+        template <std::size_t I>
+        const typename block_type::template column_type<I>* column() const
+        {
+            return block->template column<I>().data() + offset;
+        }
+
+        const std::int32_t* int32_column(std::size_t index) const
+        {
+            const std::int32_t* data = block->int32_column(index);
+            return data ? data + offset : nullptr;
+        }
+
+        std::size_t size() const { return rows; }
+        bool empty() const { return rows == 0; }
+
+        ColumnView subview(std::size_t first, std::size_t count) const
+        {
+            return ColumnView{*block, offset + first, count};
+        }
+    private:
+        const block_type* block;
+        std::size_t offset;
+        std::size_t rows;
+    };
+
+    // consumes whole blocks of events of type E at once
+    template <typename E>
+    class ColumnarListener
+    {
+    public:
+        using view_type = typename ColumnLayout<E>::block_type::view_type;
+
+        virtual ~ColumnarListener() {}
+        virtual void handle_block(const view_type& events) = 0;
+
+        // receives the events that matched the listener predicate (only the selected rows
+        // of the block); by default every run of consecutive selected rows is handled as a block
+        virtual void handle_selection(const view_type& events, const SelectionMask& selected)
+        {
+            selected.for_each_run([&](std::size_t first, std::size_t count)
+            {
+                handle_block(events.subview(first, count));
+            });
+        }
+    };
+
+    // opt-in alternative to triggering events of type E one by one: events are
+    // accumulated column by column and delivered to the subscribers a block at a time
+    //
+    // subscribers may declare a predicate, evaluated for the whole block at once (with
+    // SIMD kernels where available) before delivery: they only get the matching rows
+    //
+    // listeners may subscribe and unsubscribe from their handlers (new subscribers get the
+    // next block, unsubscribed ones don't get the rest of this one), but must not push to
+    // or flush the stream they are handling
+    template <typename E>
+    class ColumnarStream
+    {
+    public:
+        using layout_type = ColumnLayout<E>;
+        using block_type = typename layout_type::block_type;
+        using listener_type = ColumnarListener<E>;
+
+        explicit ColumnarStream(std::size_t block_capacity = 4096)
+            : capacity{block_capacity ? block_capacity : 1}, flush_depth{0}
+        {
+            block.reserve(capacity);
+        }
+
+        SlotKey subscribe(listener_type& listener)
+        {
+            return subscribers.insert(Subscriber{&listener, Predicate{}});
+        }
+        // throws std::invalid_argument if a condition is not on a column of 32-bit integers
+        SlotKey subscribe(listener_type& listener, const Predicate& predicate)
+        {
+            for (const RangePredicate& range : predicate.get_ranges())
+            {
+                if (!block_type::is_int32_column(range.column))
+                    throw std::invalid_argument("predicates only apply to columns of 32-bit integers");
+            }
+            return subscribers.insert(Subscriber{&listener, predicate});
+        }
+        // returns false if the key is stale
+        bool unsubscribe(const SlotKey& key)
+        {
+            if (flush_depth == 0)
+                return subscribers.erase(key);
+            // erased once the flush is over, it may be iterated over
+            Subscriber* subscriber = subscribers.find(key);
+            if (!subscriber || !subscriber->listener)
+                return false;
+            subscriber->listener = nullptr;
+            pending_erasures.push_back(key);
+            return true;
+        }
+
+        void push(const E& event)
+        {
+            layout_type::append(block, event);
+            if (block.size() >= capacity)
+                flush();
+        }
+
+        // appends an event given its column values, without building the event object
+        template <typename... Values>
+        void append(const Values&... values)
+        {
+            block.append(values...);
+            if (block.size() >= capacity)
+                flush();
+        }
+
+        // delivers the pending events (if any) and starts a new block
+        void flush()
+        {
+            if (block.empty())
+                return;
+            typename listener_type::view_type events = block.view();
+            // handlers may subscribe (appending to the subscribers) and unsubscribe (erasures
+            // are deferred): iterate by index up to the count at the start of the flush
+            const std::size_t count = subscribers.size();
+            ++flush_depth;
+            try
+            {
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    // not kept across handler calls, a subscription may move the subscribers
+                    const Subscriber& subscriber = subscribers[i];
+                    if (!subscriber.listener)
+                        continue;
+                    if (subscriber.predicate.empty())
+                    {
+                        subscriber.listener->handle_block(events);
+                        continue;
+                    }
+
+                    selected.reset(events.size());
+                    for (const RangePredicate& range : subscriber.predicate.get_ranges())
+                        filter_range(events.int32_column(range.column), events.size(), range.min, range.max, selected.words());
+                    if (selected.any())
+                        subscriber.listener->handle_selection(events, selected);
+                }
+            }
+            catch (...)
+            {
+                finish_flush();
+                throw;
+            }
+            finish_flush();
+            block.clear();
+        }
+
+        std::size_t pending() const { return block.size(); }
+        std::size_t block_capacity() const { return capacity; }
+    private:
+        struct Subscriber
+        {
+            listener_type* listener;
+            Predicate predicate;
+        };
+
+        void finish_flush()
+        {
+            if (--flush_depth > 0)
+                return;
+            for (const SlotKey& key : pending_erasures)
+                subscribers.erase(key);
+            pending_erasures.clear();
+        }
+
+        std::size_t capacity;
+        block_type block;
+        SlotMap<Subscriber> subscribers;  // a null listener is unsubscribed, erased after the flush
+        SelectionMask selected; // reused across flushes
+        std::size_t flush_depth;
+        std::vector<SlotKey> pending_erasures;
+    };
+}
@@ -26,10 +26,12 @@ using namespace testing;
 #pragma GCC diagnostic pop
 
 #include <iostream>     // std::cout, std::endl
+#include <sstream>      // std::ostringstream
 #include <string>       // std::string
 #include <vector>       // std::vector
 #include <exception>    // std::exception
 #include <stdexcept>    // std::out_of_range, std::invalid_argument
+#include <thread>       // std::thread::hardware_concurrency
 
 
 /*********************************************************************
@@ -38,25 +40,68 @@ using namespace testing;
 
 void print_instructions()
 {
+    std::ostringstream usage;
+    usage << "Usage instructions: <program-executable> [-h|--help|1-" << TestSuite::test_count() << "|runner options]\n";
     static const std::string instructions_message
     (
-       "Usage instructions: <program-executable> [-h|--help|1-16]\n"
        "  - calling the program with no parameters will run all the registered tests\n"
-       "  - passing a number as a parameter will run the specified test (0-indexed).\n"
-       "  - The -h and --help flags display this message.\n\n"
+       "  - passing a number as a parameter will run the specified test (1-indexed).\n"
+       "  - The -h and --help flags display this message.\n"
+       "  - Runner options run the tests past failures and print a summary sorted by duration:\n"
+       "      --parallel[=N]   run N tests at a time (defaults to the number of cores), each in its own process\n"
+       "      --no-isolate     run the tests as threads of this process instead (unsafe for tests sharing state)\n"
+       "      --filter=TEXT    only run the tests whose name contains TEXT\n"
+       "      --report=FILE    write a JSON report of the run to FILE\n\n"
        #ifdef VERBOSE
            "Program compiled with the verbosity flag. A message will be printed to stdout describing the test execution status.\n"
        #else
            "Program compiled without verbosity. The program will silently complete with no feedback, as long as there are no errors.\n"
        #endif
     );
-    std::cout << instructions_message << std::endl;
+    std::cout << usage.str() << instructions_message << std::endl;
+}
+
+// returns false on unknown options
+bool parse_run_options( int argc, const char** argv, RunOptions& options )
+{
+    options.isolate = true;
+    for( int i = 1; i < argc; ++i )
+    {
+        std::string param = argv[i];
+
+        if( param == "--parallel" )
+            options.jobs = std::max( std::thread::hardware_concurrency(), 1u );
+        else if( param.compare( 0, 11, "--parallel=" ) == 0 )
+            options.jobs = static_cast<unsigned int>( std::atoi( param.c_str() + 11 ) );
+        else if( param == "--no-isolate" )
+            options.isolate = false;
+        else if( param.compare( 0, 9, "--filter=" ) == 0 )
+            options.filter = param.substr( 9 );
+        else if( param.compare( 0, 9, "--report=" ) == 0 )
+            options.report_path = param.substr( 9 );
+        else
+            return false;
+    }
+    return true;
 }
 
 int main( int argc, const char** argv )
 {
     try
     {
+        // runner options -> run the selected tests through the test runner
+        if( argc > 1 && std::string( argv[1] ).compare( 0, 2, "--" ) == 0 && std::string( argv[1] ) != "--help" )
+        {
+            RunOptions options;
+            if( !parse_run_options( argc, argv, options ) )
+            {
+                print("Wrong usage: unknown runner option\n", colors::red);
+                print_instructions();
+                return 2;
+            }
+            return TestSuite::run_parallel( options ) ? 0 : 1;
+        }
+
         // if no parameter supplied -> run all tests
         if( argc == 1 )
         {
@@ -2,6 +2,9 @@
 
 #pragma once
 
+#include "perfect_hash.hh"
+#include "type_info.hh"
+
 namespace cs225
 {
     class Event
@@ -14,6 +17,7 @@ namespace cs225
     class HandlerFunction
     {
     public:
+        virtual ~HandlerFunction() {}
         void handle(const Event& event)
         {
             call(event);
@@ -31,7 +35,7 @@ namespace cs225
     private:
         void call(const Event& event) override
         {
-            (instance->*handler_fn)(static_cast<const E&>(event);
+            (instance->*handler_fn)(static_cast<const E&>(event));
         }
 
         T* instance;
@@ -41,14 +45,20 @@ namespace cs225
     class EventHandler
     {
     public:
+        EventHandler() : frozen{false}
+        {}
+
+        // throws TableFrozen while the handlers are frozen
         template <typename T, typename E>
         void register_handler(T& instance, void (T::*handler_method)(const E&))
         {
+            if (frozen)
+                throw TableFrozen("the event handler is frozen, thaw it to register handlers");
             // insert the type-of-event, handler pair into the map
             TypeInfo type = type_of<E>();
             // avoid this if the entry exists
-            auto found_it = handler_map.find(type_of(event));
-            if (found_it != handle_map.end())
+            auto found_it = handler_map.find(type);
+            if (found_it != handler_map.end())
                 return;
                 
             HandlerFunction *handler = new MemberFunctionHandler<T, E> {&instance, handler_method};
@@ -60,16 +70,46 @@ namespace cs225
                 delete entry.second;
         }
 
+        // compiles the handlers into a perfect hash table, for the fastest lookups once
+        // registration is over (e.g. after startup)
+        void freeze()
+        {
+            std::vector<std::pair<std::uint64_t, HandlerFunction*>> entries;
+            for (auto& entry : handler_map)
+                entries.push_back(std::make_pair(entry.first.get_hash(), entry.second));
+            frozen_handlers.build(entries);
+            frozen = true;
+        }
+        // allows registering handlers again
+        void thaw()
+        {
+            frozen_handlers.clear();
+            frozen = false;
+        }
+        bool is_frozen() const { return frozen; }
+
         // dispatch a specific event to the appropiate handler
         void handle(const Event& event)
         {
+            // an unregistered type has no handler
+            const TypeInfo type = type_of(event);
+            if (!type.is_registered())
+                return;
+            if (frozen)
+            {
+                if (HandlerFunction* const* handler = frozen_handlers.find(type.get_hash()))
+                    (*handler)->handle(event);
+                return;
+            }
             // find the handler in the map
-            auto found_it = handler_map.find(type_of(event));
+            auto found_it = handler_map.find(type);
             // invoke the handler passing the event parameter
-            if (found_it != handle_map.end())
+            if (found_it != handler_map.end())
                 found_it->second->handle(event);
         }
     private:
-        std::map<TypeInfo, HandlerFunction*> handle_map;
+        std::map<TypeInfo, HandlerFunction*> handler_map;
+        PerfectHashMap<HandlerFunction*> frozen_handlers;
+        bool frozen;
     };
 }
\ No newline at end of file
@@ -0,0 +1,706 @@
+#include "event_dispatcher.hh"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cs225
+{
+    EventDispatcher EventDispatcher::instance;
+
+    namespace
+    {
+        // never issued by a SubscriberList, so always stale
+        const SlotKey no_subscription{0xffffffffu, 0u};
+    }
+
+    SubscriptionToken EventDispatcher::subscribe(Listener& listener, const TypeInfo& type)
+    {
+        if (frozen)
+            throw TableFrozen("the event dispatcher is frozen, thaw it to subscribe");
+        if (!type.is_registered())
+            throw UnregisteredType("can't subscribe to an unregistered type");
+        ListenerHandle handle = find_handle(listener);
+        return SubscriptionToken{type, add_subscription(get_subscribers(type), listener, handle)};
+    }
+
+    ScopedSubscription EventDispatcher::subscribe_scoped(Listener& listener, const TypeInfo& type)
+    {
+        return ScopedSubscription{*this, subscribe(listener, type)};
+    }
+
+    SlotKey EventDispatcher::add_subscription(TypeSubscribers& entry, Listener& listener, ListenerHandle& handle)
+    {
+        if (handle == 0)
+            handle = acquire_handle(listener);
+        else if (listener_subscriptions[handle].contains(entry.slot))
+            return no_subscription;
+        else
+            listener_references[handle]++;
+
+        SubscriberList& listeners = entry.listeners;
+        SlotKey key;
+        if (dispatch_depth == 0)
+        {
+            key = listeners.insert(handle);
+        }
+        else
+        {
+            // reserve the slot now (so the token is valid right away) and activate it later
+            key = listeners.insert(0);
+            pending_changes.push_back(PendingChange{&listeners, key, handle, false});
+        }
+        listener_subscriptions[handle].insert(entry.slot, key);
+        return key;
+    }
+
+    bool EventDispatcher::unsubscribe(const SubscriptionToken& token)
+    {
+        TypeSubscribers* found = find_subscribers(token.type);
+        if (!found)
+            return false;
+
+        SubscriberList& listeners = found->listeners;
+        ListenerHandle* entry = listeners.find(token.key);
+        if (!entry)
+            return false;
+
+        ListenerHandle handle = *entry;
+        ListenerHandle owner = handle;
+        if (handle == 0)
+        {
+            // a subscription buffered by this dispatch, unless it was unsubscribed already
+            // (then the token is as stale as it will be once the dispatch is over)
+            owner = placeholder_listener(listeners, token.key);
+            if (owner == 0 || is_erase_pending(listeners, token.key))
+                return false;
+        }
+        listener_subscriptions[owner].erase(found->slot);
+        // a null handle isn't in the frozen table (and would match its holes)
+        if (frozen && handle != 0)
+            punch_hole(token.type, listener_table[handle]);
+        if (dispatch_depth == 0)
+        {
+            erase_subscription(listeners, token.key, handle);
+            return true;
+        }
+        *entry = 0;
+        pending_changes.push_back(PendingChange{&listeners, token.key, handle, true});
+        return true;
+    }
+
+    void EventDispatcher::unsubscribe(Listener& listener, const TypeInfo& type)
+    {
+        TypeSubscribers* found = find_subscribers(type);
+        auto handle_it = listener_handles.find(&listener);
+        if (!found || handle_it == listener_handles.end())
+            return;
+
+        if (const SlotKey* key = listener_subscriptions[handle_it->second].find(found->slot))
+            unsubscribe(SubscriptionToken{type, *key});
+    }
+
+    void EventDispatcher::unsubscribe_all(Listener& listener)
+    {
+        auto handle_it = listener_handles.find(&listener);
+        if (handle_it == listener_handles.end())
+            return;
+
+        const ListenerHandle handle = handle_it->second;
+        SubscriptionSet& types = listener_subscriptions[handle];
+        std::size_t released = 0;
+        types.for_each([&](std::uint32_t slot, const SlotKey& key)
+        {
+            SubscriberList& listeners = subscribers[slot].listeners;
+            ListenerHandle* entry = listeners.find(key);
+            if (!entry)
+                return;
+            if (frozen)
+                punch_hole(subscribers[slot].type, &listener);
+            if (dispatch_depth == 0)
+            {
+                listeners.erase(key);
+                released++;
+            }
+            else
+            {
+                pending_changes.push_back(PendingChange{&listeners, key, *entry, true});
+                *entry = 0;
+            }
+        });
+        types.clear();
+        // the last release frees the handle (and its set)
+        for (; released > 0; --released)
+            release_handle(handle);
+    }
+
+    void EventDispatcher::dispose(std::unique_ptr<Listener> listener)
+    {
+        if (dispatch_depth > 0)
+            disposed_listeners.push_back(std::move(listener));
+    }
+
+    bool EventDispatcher::is_subscribed(Listener& listener, const TypeInfo& type) const
+    {
+        const TypeSubscribers* found = find_subscribers(type);
+        auto handle_it = listener_handles.find(&listener);
+        return found && handle_it != listener_handles.end() && listener_subscriptions[handle_it->second].contains(found->slot);
+    }
+
+    void EventDispatcher::clear()
+    {
+        if (dispatch_depth == 0)
+        {
+            thaw();
+            // the listeners may go away once unsubscribed
+            flush_demoted();
+            for (TypeSubscribers& entry : subscribers)
+                entry.listeners.clear();
+            listener_table.assign(1, nullptr);
+            listener_references.assign(1, 0u);
+            listener_offenses.assign(1, 0u);
+            listener_subscriptions.assign(1, SubscriptionSet());
+            free_handles.clear();
+            listener_handles.clear();
+            return;
+        }
+
+        // the frozen table may be being read
+        if (frozen)
+        {
+            std::fill(frozen_listeners.begin(), frozen_listeners.end(), nullptr);
+            thaw_pending = true;
+        }
+        // only the subscriptions that exist now are cleared, later ones survive the batch
+        for (SubscriptionSet& types : listener_subscriptions)
+            types.clear();
+        for (TypeSubscribers& entry : subscribers)
+        {
+            SubscriberList& listeners = entry.listeners;
+            for (std::size_t i = 0; i < listeners.size(); ++i)
+            {
+                pending_changes.push_back(PendingChange{&listeners, listeners.key_at(i), listeners[i], true});
+                listeners[i] = 0;
+            }
+        }
+    }
+
+    void EventDispatcher::set_reentrancy_policy(ReentrancyPolicy policy, std::size_t max_depth)
+    {
+        reentrancy_policy = policy;
+        max_dispatch_depth = max_depth;
+    }
+
+    bool EventDispatcher::must_queue() const
+    {
+        switch (reentrancy_policy)
+        {
+            case ReentrancyPolicy::immediate: return false;
+            case ReentrancyPolicy::queued: return true;
+            case ReentrancyPolicy::depth_limited: return dispatch_depth >= max_dispatch_depth;
+        }
+        return false;
+    }
+
+    void EventDispatcher::trigger_event(const Event& event, const TypeInfo& type)
+    {
+        dispatch(event, type);
+    }
+
+    void EventDispatcher::trigger_event(const SharedEvent& event)
+    {
+        dispatch(*event, event.get_type(), nullptr, &event);
+    }
+
+    bool EventDispatcher::has_subscribers(const TypeInfo& type) const
+    {
+        if (frozen)
+        {
+            // a table cleared by a dispatch in progress has nothing but holes
+            const FrozenRange* range = frozen_types.find(type.get_hash());
+            return !thaw_pending && range && range->live != 0;
+        }
+        const TypeSubscribers* found = find_subscribers(type);
+        return found && !found->listeners.empty();
+    }
+
+    bool EventDispatcher::enqueue(SharedEvent& event, const TypeInfo& type)
+    {
+        QueuedEvent queued{type, std::move(event)};
+        // a dropped event counts as handled
+        if (queued_events.try_push(queued) != PushResult::would_block)
+            return true;
+        event = std::move(queued.event);
+        return false;
+    }
+
+    void EventDispatcher::set_queue_limit(const QueueLimit& limit)
+    {
+        queued_events.set_limit(limit);
+    }
+
+    void EventDispatcher::set_queue_limit(const TypeInfo& type, const QueueLimit& limit)
+    {
+        queued_events.set_class_limit(type.get_hash(), limit);
+    }
+
+    QueueCounters EventDispatcher::get_queue_counters() const
+    {
+        return queued_events.get_counters();
+    }
+
+    QueueCounters EventDispatcher::get_queue_counters(const TypeInfo& type) const
+    {
+        return queued_events.get_class_counters(type.get_hash());
+    }
+
+    MemoryUsage EventDispatcher::get_memory_usage(const TypeInfo& type) const
+    {
+        const TypeSubscribers* found = find_subscribers(type);
+        if (!found)
+            return MemoryUsage{0, 0};
+        return MemoryUsage{found->listeners.size(), sizeof(TypeSubscribers) + found->listeners.heap_bytes()};
+    }
+
+    MemoryUsage EventDispatcher::get_memory_usage() const
+    {
+        MemoryUsage usage{0, 0};
+        for (const TypeSubscribers& entry : subscribers)
+        {
+            usage.subscriptions += entry.listeners.size();
+            usage.bytes += sizeof(TypeSubscribers) + entry.listeners.heap_bytes();
+        }
+        usage.bytes += type_index.capacity() * sizeof(type_index[0]);
+        usage.bytes += listener_table.capacity() * sizeof(Listener*);
+        usage.bytes += listener_references.capacity() * sizeof(std::uint32_t);
+        usage.bytes += listener_subscriptions.capacity() * sizeof(SubscriptionSet);
+        for (const SubscriptionSet& types : listener_subscriptions)
+            usage.bytes += types.heap_bytes();
+        usage.bytes += free_handles.capacity() * sizeof(ListenerHandle);
+        usage.bytes += frozen_types.heap_bytes() + frozen_listeners.capacity() * sizeof(Listener*);
+        // a node per listener (next pointer and value) plus the bucket array
+        using HandleNode = std::pair<void*, std::pair<Listener*, ListenerHandle>>;
+        usage.bytes += listener_handles.size() * sizeof(HandleNode) + listener_handles.bucket_count() * sizeof(void*);
+        return usage;
+    }
+
+    void EventDispatcher::shrink_to_fit()
+    {
+        for (TypeSubscribers& entry : subscribers)
+            entry.listeners.shrink_to_fit();
+        type_index.shrink_to_fit();
+        listener_table.shrink_to_fit();
+        listener_references.shrink_to_fit();
+        listener_subscriptions.shrink_to_fit();
+        free_handles.shrink_to_fit();
+    }
+
+    void EventDispatcher::freeze()
+    {
+        if (dispatch_depth > 0)
+            throw std::logic_error("the event dispatcher can't be frozen from inside a handler");
+        if (frozen)
+            return;
+
+        std::vector<std::pair<std::uint64_t, FrozenRange>> entries;
+        frozen_listeners.clear();
+        for (const TypeSubscribers& entry : subscribers)
+        {
+            if (entry.listeners.empty())
+                continue;
+            FrozenRange range{static_cast<std::uint32_t>(frozen_listeners.size()), 0u, 0u};
+            for (ListenerHandle handle : entry.listeners)
+            {
+                if (Listener* listener = listener_table[handle])
+                {
+                    frozen_listeners.push_back(listener);
+                    range.count++;
+                    range.live++;
+                }
+            }
+            entries.push_back(std::make_pair(entry.type.get_hash(), range));
+        }
+        frozen_listeners.shrink_to_fit();
+        frozen_types.build(entries);
+        frozen = true;
+    }
+
+    void EventDispatcher::thaw()
+    {
+        if (dispatch_depth > 0)
+            throw std::logic_error("the event dispatcher can't be thawed from inside a handler");
+        frozen_types.clear();
+        std::vector<Listener*>().swap(frozen_listeners);
+        frozen = false;
+        thaw_pending = false;
+    }
+
+    void EventDispatcher::punch_hole(const TypeInfo& type, Listener* listener)
+    {
+        FrozenRange* range = frozen_types.find(type.get_hash());
+        if (!range)
+            return;
+        for (std::uint32_t i = range->first; i < range->first + range->count; ++i)
+        {
+            if (frozen_listeners[i] == listener)
+            {
+                frozen_listeners[i] = nullptr;
+                range->live--;
+            }
+        }
+    }
+
+    void EventDispatcher::set_latency_budget(const LatencyBudget& budget)
+    {
+        latency_budget = budget;
+        // every handler is timed until a dispatch shows none of them is slow
+        for (TypeSubscribers& entry : subscribers)
+            entry.timed_handlers = true;
+    }
+
+    bool EventDispatcher::is_demoted(Listener& listener) const
+    {
+        auto found_it = listener_handles.find(&listener);
+        return found_it != listener_handles.end() && is_demoted(found_it->second);
+    }
+
+    bool EventDispatcher::is_demoted(ListenerHandle handle) const
+    {
+        return latency_budget.demote_after != 0 && listener_offenses[handle] >= latency_budget.demote_after;
+    }
+
+    EventDispatcher::TypeSubscribers* EventDispatcher::find_subscribers(const TypeInfo& type)
+    {
+        const EventDispatcher& self = *this;
+        return const_cast<TypeSubscribers*>(self.find_subscribers(type));
+    }
+
+    const EventDispatcher::TypeSubscribers* EventDispatcher::find_subscribers(const TypeInfo& type) const
+    {
+        const std::uint64_t hash = type.get_hash();
+        auto found_it = std::lower_bound(type_index.begin(), type_index.end(), hash,
+            [](const std::pair<std::uint64_t, std::uint32_t>& entry, std::uint64_t key) { return entry.first < key; });
+        if (found_it == type_index.end() || found_it->first != hash)
+            return nullptr;
+        return &subscribers[found_it->second];
+    }
+
+    EventDispatcher::TypeSubscribers& EventDispatcher::get_subscribers(const TypeInfo& type)
+    {
+        if (TypeSubscribers* found = find_subscribers(type))
+            return *found;
+
+        const std::uint64_t hash = type.get_hash();
+        auto position_it = std::lower_bound(type_index.begin(), type_index.end(), std::make_pair(hash, 0u));
+        type_index.insert(position_it, std::make_pair(hash, static_cast<std::uint32_t>(subscribers.size())));
+        subscribers.emplace_back(type, static_cast<std::uint32_t>(subscribers.size()));
+        return subscribers.back();
+    }
+
+    ListenerHandle EventDispatcher::find_handle(Listener& listener) const
+    {
+        auto found_it = listener_handles.find(&listener);
+        return found_it != listener_handles.end() ? found_it->second : 0;
+    }
+
+    ListenerHandle EventDispatcher::acquire_handle(Listener& listener)
+    {
+        auto found_it = listener_handles.find(&listener);
+        if (found_it != listener_handles.end())
+        {
+            listener_references[found_it->second]++;
+            return found_it->second;
+        }
+
+        ListenerHandle handle;
+        if (!free_handles.empty())
+        {
+            handle = free_handles.back();
+            free_handles.pop_back();
+            listener_table[handle] = &listener;
+        }
+        else
+        {
+            handle = static_cast<ListenerHandle>(listener_table.size());
+            listener_table.push_back(&listener);
+            listener_references.push_back(0u);
+            listener_offenses.push_back(0u);
+            listener_subscriptions.push_back(SubscriptionSet());
+        }
+        listener_references[handle] = 1u;
+        listener_offenses[handle] = 0u;
+        listener_handles.emplace(&listener, handle);
+        return handle;
+    }
+
+    void EventDispatcher::release_handle(ListenerHandle handle)
+    {
+        if (--listener_references[handle] != 0)
+            return;
+        // the listener may go away once unsubscribed
+        if (is_demoted(handle))
+            flush_demoted();
+        listener_handles.erase(listener_table[handle]);
+        listener_table[handle] = nullptr;
+        free_handles.push_back(handle);
+    }
+
+    ListenerHandle EventDispatcher::placeholder_listener(const SubscriberList& listeners, const SlotKey& key) const
+    {
+        for (const PendingChange& change : pending_changes)
+        {
+            if (!change.erase && change.listeners == &listeners && change.key == key)
+                return change.listener;
+        }
+        return 0;
+    }
+
+    bool EventDispatcher::is_erase_pending(const SubscriberList& listeners, const SlotKey& key) const
+    {
+        for (const PendingChange& change : pending_changes)
+        {
+            if (change.erase && change.listeners == &listeners && change.key == key)
+                return true;
+        }
+        return false;
+    }
+
+    void EventDispatcher::erase_subscription(SubscriberList& listeners, const SlotKey& key, ListenerHandle listener)
+    {
+        if (listeners.erase(key) && listener != 0)
+            release_handle(listener);
+    }
+
+    void EventDispatcher::dispatch(const Event& event, const TypeInfo& type, EventCopier copy,
+                                   const SharedEvent* shared)
+    {
+        deliver(event, type, copy, shared);
+        if (dispatch_depth == 0 && !draining)
+            drain_queued_events();
+    }
+
+    void EventDispatcher::deliver(const Event& event, const TypeInfo& type, EventCopier copy,
+                                  const SharedEvent* shared)
+    {
+        // a frozen table is read directly, unless the handlers are being timed
+        if (frozen && !latency_budget.enabled())
+        {
+            if (const FrozenRange* range = frozen_types.find(type.get_hash()))
+                deliver_frozen(event, *range);
+            return;
+        }
+
+        TypeSubscribers* found = find_subscribers(type);
+        if (!found)
+            return;
+
+        // no structural change can happen while iterating (they are buffered), but
+        // buffered subscriptions may append to the collection: iterate by index up
+        // to the size at the start of the dispatch
+        SubscriberList& listeners = found->listeners;
+        const std::size_t count = listeners.size();
+
+        ++dispatch_depth;
+        try
+        {
+            if (latency_budget.enabled())
+            {
+                deliver_watched(event, *found, count, copy, shared);
+            }
+            else
+            {
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    if (Listener* listener = listener_table[listeners[i]])
+                        listener->handle_event(event);
+                }
+            }
+        }
+        catch (...)
+        {
+            abort_delivery();
+            throw;
+        }
+        finish_delivery();
+    }
+
+    void EventDispatcher::deliver_frozen(const Event& event, const FrozenRange& range)
+    {
+        // the table doesn't change while frozen, unsubscribing only nulls its entries
+        ++dispatch_depth;
+        try
+        {
+            for (std::uint32_t i = range.first; i < range.first + range.count; ++i)
+            {
+                if (Listener* listener = frozen_listeners[i])
+                    listener->handle_event(event);
+            }
+        }
+        catch (...)
+        {
+            abort_delivery();
+            throw;
+        }
+        finish_delivery();
+    }
+
+    void EventDispatcher::deliver_watched(const Event& event, TypeSubscribers& entry, std::size_t count,
+                                          EventCopier copy, const SharedEvent* shared)
+    {
+        using clock = std::chrono::steady_clock;
+        const std::chrono::nanoseconds per_listener = latency_budget.per_listener;
+        // a dispatch within the listener budget as a whole has no slow handler: the following
+        // ones take two clock reads instead of one per handler, until one is over that budget
+        const bool timed_handlers = per_listener != std::chrono::nanoseconds::zero() && entry.timed_handlers;
+        SubscriberList& listeners = entry.listeners;
+        const clock::time_point dispatch_start = clock::now();
+        // when timed one by one, the end of a handler is the start of the next one
+        clock::time_point start = dispatch_start;
+        bool offended = false;
+        // made on the first demoted listener, then shared by the rest (or not made at all)
+        SharedEvent demoted_event;
+        bool demoted_copied = false;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const ListenerHandle handle = listeners[i];
+            Listener* listener = listener_table[handle];
+            if (!listener)
+                continue;
+
+            if (is_demoted(handle))
+            {
+                if (!demoted_copied)
+                {
+                    demoted_event = shared ? *shared : copy ? copy(event) : SharedEvent{};
+                    demoted_copied = true;
+                }
+                if (demoted_event)
+                {
+                    demoted_worker.post(*listener, demoted_event);
+                    if (timed_handlers)
+                        start = clock::now();
+                    continue;
+                }
+            }
+
+            listener->handle_event(event);
+            if (!timed_handlers)
+                continue;
+            const clock::time_point end = clock::now();
+            const std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+            start = end;
+            if (elapsed > per_listener)
+            {
+                // the listener may have unsubscribed itself, but it is still in the table
+                slow_handlers.record(SlowHandlerRecord{typeid(*listener).name(), entry.type.get_name(), elapsed});
+                listener_offenses[handle]++;
+                offended = true;
+            }
+        }
+
+        const std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            (timed_handlers ? start : clock::now()) - dispatch_start);
+        if (timed_handlers)
+            entry.timed_handlers = offended;
+        else if (per_listener != std::chrono::nanoseconds::zero() && elapsed > per_listener)
+            entry.timed_handlers = true;
+
+        const std::chrono::nanoseconds per_dispatch = latency_budget.per_dispatch;
+        if (per_dispatch != std::chrono::nanoseconds::zero() && elapsed > per_dispatch)
+            slow_handlers.record(SlowHandlerRecord{nullptr, entry.type.get_name(), elapsed});
+    }
+
+    void EventDispatcher::finish_delivery()
+    {
+        if (--dispatch_depth == 0)
+        {
+            apply_pending_changes();
+            if (thaw_pending)
+                thaw();
+            // moved out first, in case destroying them disposes of more listeners
+            std::vector<std::unique_ptr<Listener>> disposed;
+            disposed.swap(disposed_listeners);
+        }
+    }
+
+    void EventDispatcher::abort_delivery()
+    {
+        finish_delivery();
+        // events queued by a failed dispatch are dropped along with it
+        if (dispatch_depth == 0 && !draining)
+            discard_queued_events();
+    }
+
+    void EventDispatcher::apply_pending_changes()
+    {
+        // applied in request order, so a buffered subscription that was also
+        // unsubscribed within the same dispatch gets activated and then erased
+        for (const PendingChange& change : pending_changes)
+        {
+            ListenerHandle* entry = change.listeners->find(change.key);
+            if (!change.erase)
+            {
+                if (entry)
+                    *entry = change.listener;
+                else
+                    release_handle(change.listener);
+            }
+            else if (entry)
+            {
+                // a placeholder was activated by an earlier change
+                erase_subscription(*change.listeners, change.key, change.listener ? change.listener : *entry);
+            }
+        }
+        pending_changes.clear();
+    }
+
+    void EventDispatcher::drain_queued_events()
+    {
+        draining = true;
+        try
+        {
+            QueuedEvent queued;
+            while (queued_events.try_pop(queued))
+                deliver(*queued.event, queued.type, nullptr, &queued.event);
+        }
+        catch (...)
+        {
+            discard_queued_events();
+            throw;
+        }
+        draining = false;
+    }
+
+    void EventDispatcher::discard_queued_events()
+    {
+        queued_events.clear();
+        draining = false;
+    }
+
+    std::ostream& operator<<(std::ostream& os, const EventDispatcher& dispatcher)
+    {
+        // the table is ordered by type hash, print it ordered by type name
+        using Entry = EventDispatcher::TypeSubscribers;
+        std::vector<const Entry*> entries;
+        for (const Entry& entry : dispatcher.subscribers)
+        {
+            if (!entry.listeners.empty())
+                entries.push_back(&entry);
+        }
+        std::sort(entries.begin(), entries.end(), [](const Entry* a, const Entry* b)
+        {
+            return std::strcmp(a->type.get_name(), b->type.get_name()) < 0;
+        });
+
+        for (const Entry* entry : entries)
+        {
+            os << "The event type " << entry->type.get_name() << " has the following subscribers:\n";
+            for (ListenerHandle handle : entry->listeners)
+            {
+                if (const Listener* listener = dispatcher.listener_table[handle])
+                    os << "\tAn instance of type " << typeid(*listener).name() << "\n";
+            }
+        }
+        return os;
+    }
+}
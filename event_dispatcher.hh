@@ -1,5 +1,27 @@
 #pragma once
 
+#include "bounded_queue.hh"
+#include "event.hh"
+#include "perfect_hash.hh"
+#include "shared_event.hh"
+#include "slot_map.hh"
+#include "subscriber_list.hh"
+#include "subscription_set.hh"
+#include "type_info.hh"
+#include "watchdog.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <ostream>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 namespace cs225
 {
     class Listener
@@ -9,6 +31,46 @@ namespace cs225
         virtual void handle_event(const Event&) = 0;
     };
 
+    // identifies a single subscription; unsubscribing through it is O(1)
+    // tokens become stale once unsubscribed or after EventDispatcher::clear
+    struct SubscriptionToken
+    {
+        TypeInfo type;
+        SlotKey key;
+    };
+
+    class ScopedSubscription;
+
+    // an event waiting in a queue (possibly shared with other queues)
+    struct QueuedEvent
+    {
+        TypeInfo type;
+        SharedEvent event;
+    };
+
+    // groups queued events by type, for per-type queue limits
+    struct ClassifyByType
+    {
+        std::uint64_t operator()(const QueuedEvent& queued) const { return queued.type.get_hash(); }
+    };
+
+    using EventQueueStorage = BoundedQueue<QueuedEvent, ClassifyByType>;
+
+    // memory taken by subscriptions, see EventDispatcher::get_memory_usage
+    struct MemoryUsage
+    {
+        std::size_t subscriptions;
+        std::size_t bytes;
+    };
+
+    // what to do with an event triggered from inside a handler (while another event is being dispatched)
+    enum class ReentrancyPolicy
+    {
+        immediate,      // dispatch it right away, nested inside the current dispatch
+        queued,         // dispatch it after the outermost dispatch finishes, in trigger order
+        depth_limited   // dispatch it right away unless the nesting limit is reached, queue it otherwise
+    };
+
     class EventDispatcher
     {
     public:
@@ -16,9 +78,393 @@ namespace cs225
         {
             return instance;
         }
+
+        // structural changes (subscribe, unsubscribe, clear) requested from inside a handler are
+        // buffered and applied in one batch once the outermost dispatch finishes, so that dispatch
+        // can iterate the subscribers in place; buffered subscribers don't receive the events in
+        // flight, and unsubscribed ones stop receiving them right away
+
+        // a listener subscribes at most once to each type: subscribing again changes nothing
+        // and returns a stale token; throws UnregisteredType for an unregistered type
+        SubscriptionToken subscribe(Listener& listener, const TypeInfo& type);
+        // same as subscribe, but the subscription is dropped when the returned handle dies
+        ScopedSubscription subscribe_scoped(Listener& listener, const TypeInfo& type);
+
+        // returns false if the token was stale
+        bool unsubscribe(const SubscriptionToken& token);
+        // removes the subscription of the listener to the type, if any
+        void unsubscribe(Listener& listener, const TypeInfo& type);
+        // removes every subscription of the listener (e.g. before destroying it), touching only
+        // the types it is subscribed to
+        void unsubscribe_all(Listener& listener);
+        bool is_subscribed(Listener& listener, const TypeInfo& type) const;
+        // destroys an (unsubscribed) listener the dispatcher owns from then on, once no dispatch
+        // is in progress: its own handler may be the one running
+        void dispose(std::unique_ptr<Listener> listener);
+
+        template <typename E>
+        void trigger_event(const E& event);
+        // triggers an event whose type was computed beforehand (e.g. taken out of a queue)
+        // it is never queued by the reentrancy policy, since it can't be copied
+        void trigger_event(const Event& event, const TypeInfo& type);
+        // same, for an event that demoted listeners can share
+        void trigger_event(const SharedEvent& event);
+        // constructs an E from args and triggers it, but only if E has subscribers; the event is
+        // constructed once, in place (in the queue if the reentrancy policy queues it)
+        template <typename E, typename... Args>
+        void trigger(Args&&... args);
+        // same as trigger, but the event is returned by factory (only called if E has subscribers)
+        // and constructed from its result, in place in the queue (see EventPool::make_with)
+        template <typename E, typename Factory>
+        void trigger_lazy(Factory&& factory);
+
+        // true if events of the type would reach some listener (also counts subscriptions
+        // buffered by a dispatch in progress)
+        bool has_subscribers(const TypeInfo& type) const;
+        template <typename E>
+        bool has_subscribers() const { return has_subscribers(type_of<E>()); }
+
+        void clear();
+
+        // max_depth only applies to ReentrancyPolicy::depth_limited
+        void set_reentrancy_policy(ReentrancyPolicy policy, std::size_t max_depth = 8);
+        ReentrancyPolicy get_reentrancy_policy() const { return reentrancy_policy; }
+
+        // bounds the queue of re-entrant events (in total or per event type)
+        // the producer of a re-entrant event is the dispatch itself, so it can't wait for room:
+        // with OverflowPolicy::block an event that doesn't fit is dispatched immediately instead
+        void set_queue_limit(const QueueLimit& limit);
+        void set_queue_limit(const TypeInfo& type, const QueueLimit& limit);
+        QueueCounters get_queue_counters() const;
+        QueueCounters get_queue_counters(const TypeInfo& type) const;
+
+        // the subscriptions to a type and the bytes their list takes
+        MemoryUsage get_memory_usage(const TypeInfo& type) const;
+        // all the subscriptions, and the bytes taken by the subscriber lists, the type table
+        // and the listener table (hash table nodes are estimated)
+        MemoryUsage get_memory_usage() const;
+        // gives back the growth slack of the subscriber lists and tables (e.g. after startup)
+        void shrink_to_fit();
+
+        // compiles the subscriptions into a read-only table (a perfect hash of the types into
+        // one contiguous array of listeners) that dispatches read until thaw is called
+        // while frozen, subscribing throws TableFrozen, unsubscribing still works (it leaves a
+        // hole in the table) and clear thaws the table; freeze and thaw can't be called from
+        // a handler (std::logic_error)
+        void freeze();
+        void thaw();
+        bool is_frozen() const { return frozen; }
+
+        // slow-handler watchdog: while a budget is set, dispatches are timed, and the handlers
+        // (or whole dispatches) over budget are recorded in the slow handler log
+        // handlers are timed one by one until a dispatch of their type shows none of them is
+        // slow, then only the whole dispatch is; one over the listener budget turns per-handler
+        // timing back on, so a handler that turns slow is recorded from its next event on
+        // a listener over budget too many times is demoted: it gets its events on a worker
+        // thread instead (so it must not use the dispatcher and must tolerate running
+        // concurrently with the dispatching thread); events that can't be copied (triggered
+        // through a base class reference) are still delivered to it synchronously
+        void set_latency_budget(const LatencyBudget& budget);
+        const LatencyBudget& get_latency_budget() const { return latency_budget; }
+        SlowHandlerLog& get_slow_handlers() { return slow_handlers; }
+        const SlowHandlerLog& get_slow_handlers() const { return slow_handlers; }
+        bool is_demoted(Listener& listener) const;
+        // waits until demoted listeners handled the events sent their way
+        void flush_demoted() { demoted_worker.flush(); }
+        const AsyncDeliveryWorker& get_demoted_worker() const { return demoted_worker; }
+        // the events waiting for demoted listeners are bounded (see AsyncDeliveryWorker)
+        void set_demoted_queue_limit(const QueueLimit& limit) { demoted_worker.set_queue_limit(limit); }
+        std::uint64_t get_demoted_dropped() const { return demoted_worker.get_dropped(); }
+        // where the demoted listeners' worker thread runs
+        void set_worker_placement(const ThreadPlacement& placement) { demoted_worker.set_placement(placement); }
+
+        friend std::ostream& operator<<(std::ostream& os, const EventDispatcher& dispatcher);
     private:
+        EventDispatcher()
+            : listener_table(1, nullptr), listener_references(1, 0u), listener_offenses(1, 0u)
+            , listener_subscriptions(1)
+            , reentrancy_policy{ReentrancyPolicy::immediate}, max_dispatch_depth{8}
+            , dispatch_depth{0}, draining{false}, frozen{false}, thaw_pending{false}
+        {}
+        EventDispatcher(const EventDispatcher&) = delete;
+        EventDispatcher& operator=(const EventDispatcher&) = delete;
+
+        // buffered structural change: activates the placeholder at key with listener, or erases the
+        // subscription at key (listener is then the one it had, unless it was a placeholder)
+        struct PendingChange
+        {
+            SubscriberList* listeners;
+            SlotKey key;
+            ListenerHandle listener;
+            bool erase;
+        };
+
+        // the listeners of a type in the frozen table
+        struct FrozenRange
+        {
+            std::uint32_t first;
+            std::uint32_t count;
+            std::uint32_t live;             // the entries that aren't holes
+        };
+
+        struct TypeSubscribers
+        {
+            TypeSubscribers(const TypeInfo& event_type, std::uint32_t index)
+                : type(event_type), slot{index}, timed_handlers{true}
+            {}
+
+            TypeInfo type;
+            std::uint32_t slot;             // position in the table, the bit of the type in SubscriptionSets
+            SubscriberList listeners;
+            bool timed_handlers;            // the watchdog times each handler, not just the whole dispatch
+        };
+
+        // gives an event its own SharedEvent copy (for delivery to demoted listeners)
+        using EventCopier = SharedEvent (*)(const Event&);
+        template <typename E>
+        using copyable_event = std::integral_constant<bool,
+            !std::is_abstract<E>::value && std::is_copy_constructible<E>::value>;
+        template <typename E>
+        static SharedEvent copy_event(const Event& event);
+        template <typename E>
+        static EventCopier copier_of(std::true_type) { return &copy_event<E>; }
+        template <typename E>
+        static EventCopier copier_of(std::false_type) { return nullptr; }
+
+        bool must_queue() const;
+        // only events whose static and dynamic types match can be copied into the queue
+        template <typename E>
+        bool enqueue(const E& event, const TypeInfo& type, std::true_type);
+        template <typename E>
+        bool enqueue(const E&, const TypeInfo&, std::false_type) { return false; }
+        // takes the event unless it has to be dispatched right away (the queue is full and blocking)
+        bool enqueue(SharedEvent& event, const TypeInfo& type);
+
+        TypeSubscribers* find_subscribers(const TypeInfo& type);
+        const TypeSubscribers* find_subscribers(const TypeInfo& type) const;
+        TypeSubscribers& get_subscribers(const TypeInfo& type);
+        // a listener has a handle while it has subscriptions, reference counted by them
+        ListenerHandle acquire_handle(Listener& listener);
+        void release_handle(ListenerHandle handle);
+        // the listener a placeholder (a subscription made while dispatching) will be activated with
+        ListenerHandle placeholder_listener(const SubscriberList& listeners, const SlotKey& key) const;
+        // true if the subscription at key was unsubscribed by the dispatch in progress
+        bool is_erase_pending(const SubscriberList& listeners, const SlotKey& key) const;
+        void erase_subscription(SubscriberList& listeners, const SlotKey& key, ListenerHandle listener);
+        // subscribes right away, or buffers the subscription while dispatching
+        // handle is the listener's handle, 0 if it has none yet (then it is set to the new one)
+        SlotKey add_subscription(TypeSubscribers& entry, Listener& listener, ListenerHandle& handle);
+        // the handle of a subscribed listener, 0 if it has none
+        ListenerHandle find_handle(Listener& listener) const;
+        // takes an unsubscribed listener out of the frozen table
+        void punch_hole(const TypeInfo& type, Listener* listener);
+
+        // demoted listeners share the event if it is given, or a copy otherwise
+        void dispatch(const Event& event, const TypeInfo& type, EventCopier copy = nullptr,
+                      const SharedEvent* shared = nullptr);
+        void deliver(const Event& event, const TypeInfo& type, EventCopier copy, const SharedEvent* shared);
+        void deliver_watched(const Event& event, TypeSubscribers& entry, std::size_t count,
+                             EventCopier copy, const SharedEvent* shared);
+        bool is_demoted(ListenerHandle handle) const;
+        void deliver_frozen(const Event& event, const FrozenRange& range);
+        void finish_delivery();
+        // finishes a delivery interrupted by an exception
+        void abort_delivery();
+        void apply_pending_changes();
+        void drain_queued_events();
+        void discard_queued_events();
+
+        // subscriber lists are never erased, only emptied, so that their slot generations
+        // survive and outstanding tokens stay detectably stale; the deque keeps them in place
+        // (a null entry is a subscription that is buffered or being removed)
+        std::deque<TypeSubscribers> subscribers;
+        // (type hash, position in subscribers), sorted by hash
+        std::vector<std::pair<std::uint64_t, std::uint32_t>> type_index;
+
+        // subscriptions store 32-bit handles into listener_table instead of pointers
+        // (handle 0 is the null listener)
+        std::vector<Listener*> listener_table;
+        std::vector<std::uint32_t> listener_references;
+        std::vector<ListenerHandle> free_handles;
+        std::unordered_map<Listener*, ListenerHandle> listener_handles;
+        // times each listener went over its budget, by handle
+        std::vector<std::uint32_t> listener_offenses;
+        // the types each listener is subscribed to, by handle
+        std::vector<SubscriptionSet> listener_subscriptions;
+
+        ReentrancyPolicy reentrancy_policy;
+        std::size_t max_dispatch_depth;
+        std::size_t dispatch_depth;
+        bool draining;
+        std::vector<PendingChange> pending_changes;
+        std::vector<std::unique_ptr<Listener>> disposed_listeners;
+        EventQueueStorage queued_events;
+
+        PerfectHashMap<FrozenRange> frozen_types;
+        std::vector<Listener*> frozen_listeners;
+        bool frozen;
+        bool thaw_pending;              // cleared while frozen, thawed once the dispatch ends
+
+        LatencyBudget latency_budget;
+        SlowHandlerLog slow_handlers;
+        AsyncDeliveryWorker demoted_worker;
+
         static EventDispatcher instance;
     };
 
-    EventDispatcher EventDispatcher::instance;
-}
\ No newline at end of file
+    // move-only RAII handle that unsubscribes on destruction
+    class ScopedSubscription
+    {
+    public:
+        ScopedSubscription() : dispatcher{nullptr}, token{}
+        {}
+        ScopedSubscription(EventDispatcher& owner, const SubscriptionToken& subscription)
+            : dispatcher{&owner}, token(subscription)
+        {}
+        ScopedSubscription(ScopedSubscription&& other) : dispatcher{other.dispatcher}, token(other.token)
+        {
+            other.dispatcher = nullptr;
+        }
+        ScopedSubscription& operator=(ScopedSubscription&& other)
+        {
+            if (this != &other)
+            {
+                reset();
+                dispatcher = other.dispatcher;
+                token = other.token;
+                other.dispatcher = nullptr;
+            }
+            return *this;
+        }
+        ScopedSubscription(const ScopedSubscription&) = delete;
+        ScopedSubscription& operator=(const ScopedSubscription&) = delete;
+        ~ScopedSubscription()
+        {
+            reset();
+        }
+
+        // unsubscribe now
+        void reset()
+        {
+            if (dispatcher)
+                dispatcher->unsubscribe(token);
+            dispatcher = nullptr;
+        }
+        // give up ownership without unsubscribing
+        SubscriptionToken release()
+        {
+            dispatcher = nullptr;
+            return token;
+        }
+
+        explicit operator bool() const { return dispatcher != nullptr; }
+        const SubscriptionToken& get_token() const { return token; }
+        EventDispatcher* get_dispatcher() const { return dispatcher; }
+    private:
+        EventDispatcher* dispatcher;
+        SubscriptionToken token;
+    };
+
+    std::ostream& operator<<(std::ostream& os, const EventDispatcher& dispatcher);
+
+    template <typename E>
+    void EventDispatcher::trigger_event(const E& event)
+    {
+        // the static type is hashed at compile time, no registry lookup unless
+        // the event is triggered through a base class reference
+        TypeInfo type = type_of(event);
+        // an unregistered type has no subscribers
+        if (!type.is_registered())
+            return;
+        if (dispatch_depth > 0 && must_queue() && enqueue(event, type, copyable_event<E>{}))
+            return;
+        dispatch(event, type, copier_of<E>(copyable_event<E>{}));
+    }
+
+    template <typename E>
+    SharedEvent EventDispatcher::copy_event(const Event& event)
+    {
+        // an event triggered through a base class reference would be sliced
+        if (typeid(event) != typeid(E))
+            return SharedEvent{};
+        return make_shared_event<E>(static_cast<const E&>(event));
+    }
+
+    template <typename E>
+    bool EventDispatcher::enqueue(const E& event, const TypeInfo& type, std::true_type)
+    {
+        // an event triggered through a base class reference would be sliced
+        if (typeid(event) != typeid(E))
+            return false;
+        SharedEvent copy = make_shared_event<E>(event);
+        return enqueue(copy, type);
+    }
+
+    template <typename E, typename... Args>
+    void EventDispatcher::trigger(Args&&... args)
+    {
+        static_assert(std::is_base_of<Event, E>::value, "only events can be triggered");
+
+        const TypeInfo type = type_of<E>();
+        if (!has_subscribers(type))
+            return;
+        if (dispatch_depth > 0 && must_queue())
+        {
+            SharedEvent event = make_shared_event<E>(std::forward<Args>(args)...);
+            if (!enqueue(event, type))
+                dispatch(*event, type, nullptr, &event);
+            return;
+        }
+        const E event(std::forward<Args>(args)...);
+        dispatch(event, type, copier_of<E>(copyable_event<E>{}));
+    }
+
+    template <typename E, typename Factory>
+    void EventDispatcher::trigger_lazy(Factory&& factory)
+    {
+        static_assert(std::is_base_of<Event, E>::value, "only events can be triggered");
+
+        const TypeInfo type = type_of<E>();
+        if (!has_subscribers(type))
+            return;
+        if (dispatch_depth > 0 && must_queue())
+        {
+            // built right in the pool slot, not moved there
+            SharedEvent event = make_shared_event_with<E>(factory);
+            if (!enqueue(event, type))
+                dispatch(*event, type, nullptr, &event);
+            return;
+        }
+        // binding the returned temporary avoids a copy
+        const E& event = factory();
+        dispatch(event, type, copier_of<E>(copyable_event<E>{}));
+    }
+
+    // proxy to EventDispatcher::get_instance().trigger_event
+    template <typename E>
+    void trigger_event(const E& event)
+    {
+        EventDispatcher::get_instance().trigger_event(event);
+    }
+
+    // proxy to EventDispatcher::get_instance().trigger
+    template <typename E, typename... Args>
+    void trigger(Args&&... args)
+    {
+        EventDispatcher::get_instance().trigger<E>(std::forward<Args>(args)...);
+    }
+
+    // proxy to EventDispatcher::get_instance().trigger_lazy
+    template <typename E, typename Factory>
+    void trigger_lazy(Factory&& factory)
+    {
+        EventDispatcher::get_instance().trigger_lazy<E>(std::forward<Factory>(factory));
+    }
+
+    // proxy to EventDispatcher::get_instance().has_subscribers
+    template <typename E>
+    bool has_subscribers()
+    {
+        return EventDispatcher::get_instance().has_subscribers<E>();
+    }
+}
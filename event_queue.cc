@@ -0,0 +1,33 @@
+#include "event_queue.hh"
+
+namespace cs225
+{
+    void EventQueue::set_type_limit(const TypeInfo& type, const QueueLimit& limit)
+    {
+        events.set_class_limit(type.get_hash(), limit);
+    }
+
+    std::size_t EventQueue::pump(std::size_t max_events)
+    {
+        std::size_t count = 0;
+        QueuedEvent queued;
+        while (count < max_events && events.try_pop(queued))
+        {
+            dispatcher.trigger_event(queued.event);
+            count++;
+        }
+        return count;
+    }
+
+    void EventQueue::pump_until_closed()
+    {
+        QueuedEvent queued;
+        while (events.pop(queued))
+            dispatcher.trigger_event(queued.event);
+    }
+
+    void EventQueue::close()
+    {
+        events.close();
+    }
+}
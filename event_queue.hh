@@ -0,0 +1,57 @@
+#pragma once
+
+#include "bounded_queue.hh"
+#include "event_dispatcher.hh"
+
+#include <cstddef>
+#include <limits>
+#include <typeinfo>
+
+namespace cs225
+{
+    // bounded hand-off of events from any thread to the thread that owns the dispatcher
+    // producers post events (copies are queued), the dispatcher thread pumps them; when the
+    // dispatcher falls behind, the queue limits (in total or per event type) and their overflow
+    // policies keep memory bounded
+    class EventQueue
+    {
+    public:
+        explicit EventQueue(const QueueLimit& limit = QueueLimit{},
+                            EventDispatcher& target = EventDispatcher::get_instance())
+            : dispatcher(target), events(limit)
+        {}
+
+        // thread-safe; returns false if the event was dropped (or the queue is closed), and
+        // for an event posted through a base class reference, which would be sliced
+        // (post a SharedEvent made for its dynamic type instead)
+        template <typename E>
+        bool post(const E& event)
+        {
+            if (typeid(event) != typeid(E))
+                return false;
+            return events.push(QueuedEvent{type_of<E>(), make_shared_event<E>(event)});
+        }
+        // posts an event without copying it, so that it can be posted to many queues
+        bool post(const SharedEvent& event)
+        {
+            return events.push(QueuedEvent{event.get_type(), event});
+        }
+
+        void set_type_limit(const TypeInfo& type, const QueueLimit& limit);
+
+        // triggers up to max_events queued events, returns how many
+        // (call it from the dispatcher thread)
+        std::size_t pump(std::size_t max_events = std::numeric_limits<std::size_t>::max());
+        // triggers queued events as they arrive, until the queue is closed and empty
+        void pump_until_closed();
+        // rejects further posts and releases blocked producers
+        void close();
+
+        std::size_t size() const { return events.size(); }
+        QueueCounters get_counters() const { return events.get_counters(); }
+        QueueCounters get_counters(const TypeInfo& type) const { return events.get_class_counters(type.get_hash()); }
+    private:
+        EventDispatcher& dispatcher;
+        EventQueueStorage events;
+    };
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+#include "event.hh"
+#include "event_dispatcher.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cs225
+{
+    // composable operators on the events of a type, in place of listeners that only
+    // filter, transform or aggregate events and trigger derived ones:
+    //
+    //     StreamSubscription subscription = stream<MouseClickedEvent>()
+    //         .filter([](const MouseClickedEvent& click) { return click.position.y >= 0; })
+    //         .map([](const MouseClickedEvent& click) { return click.position.x; })
+    //         .window(16)
+    //         .subscribe([](const std::vector<int>& xs) { ... });
+    //
+    // the whole chain is put together at compile time into a single listener, so it costs
+    // one dispatch (one virtual call) per event however many stages it has; stateful
+    // operators (window, throttle) keep their state inside that listener too
+    // streams are cheap to copy, nothing is subscribed until subscribe (or trigger) is called
+
+    namespace detail
+    {
+        template <typename Predicate, typename Sink>
+        struct FilterStage
+        {
+            template <typename T>
+            void operator()(const T& value)
+            {
+                if (predicate(value))
+                    sink(value);
+            }
+            Predicate predicate;
+            Sink sink;
+        };
+
+        template <typename Function, typename Sink>
+        struct MapStage
+        {
+            template <typename T>
+            void operator()(const T& value)
+            {
+                sink(function(value));
+            }
+            Function function;
+            Sink sink;
+        };
+
+        // tumbling window: every count values are passed on together
+        template <typename T, typename Sink>
+        struct WindowStage
+        {
+            void operator()(const T& value)
+            {
+                values.push_back(value);
+                if (values.size() < count)
+                    return;
+                sink(static_cast<const std::vector<T>&>(values));
+                values.clear();
+            }
+            std::size_t count;
+            Sink sink;
+            std::vector<T> values;
+        };
+
+        // passes a value on, then drops the ones that follow it within the interval
+        template <typename Sink>
+        struct ThrottleStage
+        {
+            template <typename T>
+            void operator()(const T& value)
+            {
+                const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                if (passed_any && now - last < interval)
+                    return;
+                passed_any = true;
+                last = now;
+                sink(value);
+            }
+            std::chrono::steady_clock::duration interval;
+            Sink sink;
+            bool passed_any;
+            std::chrono::steady_clock::time_point last;
+        };
+
+        // operators as they are chained, before they know what comes after them
+        template <typename Predicate>
+        struct FilterOperator
+        {
+            template <typename Sink>
+            FilterStage<Predicate, Sink> bind(Sink sink) const { return FilterStage<Predicate, Sink>{predicate, sink}; }
+            Predicate predicate;
+        };
+
+        template <typename Function>
+        struct MapOperator
+        {
+            template <typename Sink>
+            MapStage<Function, Sink> bind(Sink sink) const { return MapStage<Function, Sink>{function, sink}; }
+            Function function;
+        };
+
+        template <typename T>
+        struct WindowOperator
+        {
+            template <typename Sink>
+            WindowStage<T, Sink> bind(Sink sink) const { return WindowStage<T, Sink>{count, sink, std::vector<T>()}; }
+            std::size_t count;
+        };
+
+        struct ThrottleOperator
+        {
+            template <typename Sink>
+            ThrottleStage<Sink> bind(Sink sink) const
+            {
+                return ThrottleStage<Sink>{interval, sink, false, std::chrono::steady_clock::time_point()};
+            }
+            std::chrono::steady_clock::duration interval;
+        };
+
+        // the chain of operators: binding it to a sink nests the stages, last one innermost
+        struct StreamSource
+        {
+            template <typename Sink>
+            Sink bind(Sink sink) const { return sink; }
+        };
+
+        template <typename Previous, typename Operator>
+        struct StreamPipe
+        {
+            template <typename Sink>
+            auto bind(Sink sink) const -> decltype(std::declval<const Previous&>().bind(std::declval<const Operator&>().bind(sink)))
+            {
+                return previous.bind(op.bind(sink));
+            }
+            Previous previous;
+            Operator op;
+        };
+
+        template <typename D>
+        struct TriggerSink
+        {
+            template <typename T>
+            void operator()(const T& value)
+            {
+                dispatcher->trigger<D>(value);
+            }
+            EventDispatcher* dispatcher;
+        };
+
+        // the single listener a whole chain is fused into
+        template <typename E, typename Stages>
+        class StreamListener : public Listener
+        {
+        public:
+            explicit StreamListener(const Stages& chain) : stages(chain)
+            {}
+            void handle_event(const Event& event) override
+            {
+                stages(static_cast<const E&>(event));
+            }
+        private:
+            Stages stages;
+        };
+    }
+
+    // keeps a stream subscribed (and its operators alive) until it is destroyed or reset
+    class StreamSubscription
+    {
+    public:
+        StreamSubscription()
+        {}
+        StreamSubscription(std::unique_ptr<Listener> stream_listener, ScopedSubscription stream_subscription)
+            : listener(std::move(stream_listener)), subscription(std::move(stream_subscription))
+        {}
+        StreamSubscription(StreamSubscription&& other)
+            : listener(std::move(other.listener)), subscription(std::move(other.subscription))
+        {}
+        StreamSubscription& operator=(StreamSubscription&& other)
+        {
+            if (this != &other)
+            {
+                reset();
+                listener = std::move(other.listener);
+                subscription = std::move(other.subscription);
+            }
+            return *this;
+        }
+        ~StreamSubscription()
+        {
+            reset();
+        }
+
+        // unsubscribe now; the operators are destroyed once the dispatch in progress (if any)
+        // is over, so a chain can reset its own subscription from its sink
+        void reset()
+        {
+            EventDispatcher* dispatcher = subscription.get_dispatcher();
+            subscription.reset();
+            if (dispatcher && listener)
+                dispatcher->dispose(std::move(listener));
+            listener.reset();
+        }
+        bool active() const { return listener != nullptr; }
+    private:
+        // declared first, so it is destroyed after the subscription
+        std::unique_ptr<Listener> listener;
+        ScopedSubscription subscription;
+    };
+
+    // the events of type E (as values of type T once mapped), going through Chain
+    template <typename E, typename T, typename Chain>
+    class EventStream
+    {
+    public:
+        EventStream(EventDispatcher& owner, const Chain& operators) : dispatcher(&owner), chain(operators)
+        {}
+
+        // passes on the values for which predicate(value) is true
+        template <typename Predicate>
+        EventStream<E, T, detail::StreamPipe<Chain, detail::FilterOperator<Predicate>>> filter(Predicate predicate) const
+        {
+            return pipe<T>(detail::FilterOperator<Predicate>{predicate});
+        }
+
+        // passes on function(value) instead of the value
+        template <typename Function,
+                  typename U = typename std::decay<typename std::result_of<Function(const T&)>::type>::type>
+        EventStream<E, U, detail::StreamPipe<Chain, detail::MapOperator<Function>>> map(Function function) const
+        {
+            return pipe<U>(detail::MapOperator<Function>{function});
+        }
+
+        // passes on the values count at a time, as a std::vector<T>
+        EventStream<E, std::vector<T>, detail::StreamPipe<Chain, detail::WindowOperator<T>>> window(std::size_t count) const
+        {
+            return pipe<std::vector<T>>(detail::WindowOperator<T>{count > 0 ? count : 1});
+        }
+
+        // passes on at most one value per interval (the first one), dropping the rest
+        EventStream<E, T, detail::StreamPipe<Chain, detail::ThrottleOperator>> throttle(std::chrono::steady_clock::duration interval) const
+        {
+            return pipe<T>(detail::ThrottleOperator{interval});
+        }
+
+        // calls function(value) for every value that makes it through the chain
+        template <typename Function>
+        StreamSubscription subscribe(Function function) const
+        {
+            using Stages = decltype(chain.bind(function));
+            std::unique_ptr<Listener> listener(new detail::StreamListener<E, Stages>(chain.bind(function)));
+            ScopedSubscription subscription = dispatcher->subscribe_scoped(*listener, type_of<E>());
+            return StreamSubscription(std::move(listener), std::move(subscription));
+        }
+
+        // triggers a D constructed from every value that makes it through the chain
+        template <typename D>
+        StreamSubscription trigger() const
+        {
+            return subscribe(detail::TriggerSink<D>{dispatcher});
+        }
+    private:
+        template <typename U, typename Operator>
+        EventStream<E, U, detail::StreamPipe<Chain, Operator>> pipe(const Operator& op) const
+        {
+            return EventStream<E, U, detail::StreamPipe<Chain, Operator>>(*dispatcher, detail::StreamPipe<Chain, Operator>{chain, op});
+        }
+
+        EventDispatcher* dispatcher;
+        Chain chain;
+    };
+
+    // the events of type E triggered through the dispatcher
+    template <typename E>
+    EventStream<E, E, detail::StreamSource> stream(EventDispatcher& dispatcher = EventDispatcher::get_instance())
+    {
+        static_assert(std::is_base_of<Event, E>::value, "only events can be streamed");
+        return EventStream<E, E, detail::StreamSource>(dispatcher, detail::StreamSource{});
+    }
+}
@@ -0,0 +1,344 @@
+#include "load_generator.hh"
+
+#include "event_dispatcher.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace loadgen
+{
+    namespace
+    {
+        using clock = std::chrono::steady_clock;
+
+        // knows its position in the type table, so listeners can count deliveries per type
+        struct IndexedEvent : public cs225::Event
+        {
+            explicit IndexedEvent(std::size_t type_index) : index{type_index}
+            {}
+            std::size_t index;
+        };
+
+        template <std::size_t N>
+        struct GeneratedEvent : public IndexedEvent
+        {
+            GeneratedEvent() : IndexedEvent{N}
+            {}
+        };
+
+        struct EventTypeEntry
+        {
+            cs225::TypeInfo type;
+            void (*trigger)();
+        };
+
+        template <std::size_t N>
+        void trigger_generated()
+        {
+            cs225::trigger_event(GeneratedEvent<N>());
+        }
+
+        // fills the table with the first N generated event types
+        template <std::size_t N>
+        struct EventTypeTable
+        {
+            static void fill(std::vector<EventTypeEntry>& table)
+            {
+                EventTypeTable<N - 1>::fill(table);
+                table.push_back(EventTypeEntry{cs225::type_of<GeneratedEvent<N - 1>>(), &trigger_generated<N - 1>});
+            }
+        };
+        template <>
+        struct EventTypeTable<0>
+        {
+            static void fill(std::vector<EventTypeEntry>&) {}
+        };
+
+        struct CountingListener : public cs225::Listener
+        {
+            explicit CountingListener(std::size_t event_types) : deliveries(event_types, 0u)
+            {}
+            void handle_event(const cs225::Event& event) override
+            {
+                ++deliveries[static_cast<const IndexedEvent&>(event).index];
+            }
+            std::vector<std::uint64_t> deliveries;  // by event type
+        };
+
+        // samples the index of an event type, rank k having a weight of 1 / (k + 1)^s
+        class ZipfSampler
+        {
+        public:
+            ZipfSampler(std::size_t count, double exponent)
+            {
+                double total = 0.0;
+                for (std::size_t k = 0; k < count; ++k)
+                {
+                    total += 1.0 / std::pow(static_cast<double>(k + 1), exponent);
+                    cdf.push_back(total);
+                }
+                for (double& value : cdf)
+                    value /= total;
+            }
+
+            template <typename Random>
+            std::size_t operator()(Random& random) const
+            {
+                double u = std::uniform_real_distribution<double>(0.0, 1.0)(random);
+                std::size_t k = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+                return std::min(k, cdf.size() - 1);
+            }
+        private:
+            std::vector<double> cdf;
+        };
+
+        enum class Operation { subscribe, unsubscribe, trigger, clear };
+
+        // the dispatcher plus the reference model of what it should deliver
+        // a subscription to type t expects one delivery per trigger of t during its lifetime,
+        // so the model only needs per-type trigger counters (no per-trigger fan-out); deliveries
+        // are checked per (listener, type), so one type delivered in place of another is caught
+        class LoadState
+        {
+        public:
+            LoadState(const LoadConfig& config)
+                : dispatcher(cs225::EventDispatcher::get_instance())
+                , listeners(config.listeners, CountingListener(config.event_types))
+                , trigger_counts(config.event_types, 0u), expected(config.listeners * config.event_types, 0u)
+            {
+                EventTypeTable<max_event_types>::fill(types);
+                types.resize(config.event_types);
+            }
+
+            void subscribe(std::size_t listener, std::size_t type)
+            {
+                // a listener subscribes at most once to each type, the dispatcher rejects the rest
+                if (dispatcher.is_subscribed(listeners[listener], types[type].type))
+                    return;
+                cs225::SubscriptionToken token = dispatcher.subscribe(listeners[listener], types[type].type);
+                live.push_back(LiveSubscription{token, listener, type, trigger_counts[type]});
+            }
+
+            // picks the subscription to remove from a random number
+            void unsubscribe(std::uint64_t random)
+            {
+                if (live.empty())
+                    return;
+                std::size_t index = static_cast<std::size_t>(random % live.size());
+                dispatcher.unsubscribe(live[index].token);
+                settle(live[index]);
+                live[index] = live.back();
+                live.pop_back();
+            }
+
+            void trigger(std::size_t type)
+            {
+                types[type].trigger();
+                trigger_counts[type]++;
+            }
+
+            void clear()
+            {
+                dispatcher.clear();
+                for (const LiveSubscription& subscription : live)
+                    settle(subscription);
+                live.clear();
+            }
+
+            // settles the remaining subscriptions and counts the mismatching listeners
+            std::size_t validate()
+            {
+                clear();
+                std::size_t mismatched = 0;
+                const std::size_t type_count = trigger_counts.size();
+                for (std::size_t i = 0; i < listeners.size(); ++i)
+                {
+                    if (!std::equal(listeners[i].deliveries.begin(), listeners[i].deliveries.end(),
+                                    expected.begin() + i * type_count))
+                        mismatched++;
+                }
+                return mismatched;
+            }
+
+            std::size_t deliveries() const
+            {
+                std::size_t total = 0;
+                for (const CountingListener& listener : listeners)
+                {
+                    for (std::uint64_t count : listener.deliveries)
+                        total += count;
+                }
+                return total;
+            }
+
+            std::mutex lock;
+        private:
+            struct LiveSubscription
+            {
+                cs225::SubscriptionToken token;
+                std::size_t listener;
+                std::size_t type;
+                std::uint64_t triggers_at_start;
+            };
+
+            void settle(const LiveSubscription& subscription)
+            {
+                expected[subscription.listener * trigger_counts.size() + subscription.type] +=
+                    trigger_counts[subscription.type] - subscription.triggers_at_start;
+            }
+
+            cs225::EventDispatcher& dispatcher;
+            std::vector<EventTypeEntry> types;
+            std::vector<CountingListener> listeners;
+            std::vector<LiveSubscription> live;
+            std::vector<std::uint64_t> trigger_counts;
+            std::vector<std::uint64_t> expected;   // by listener, then by type
+        };
+
+        void check(const LoadConfig& config)
+        {
+            if (config.event_types == 0 || config.event_types > max_event_types)
+                throw std::invalid_argument("the number of event types must be between 1 and 256");
+            if (config.listeners == 0 || config.threads == 0)
+                throw std::invalid_argument("at least one listener and one thread are required");
+            if (config.subscribe_weight < 0.0 || config.unsubscribe_weight < 0.0
+                || config.trigger_weight < 0.0 || config.clear_weight < 0.0
+                || config.subscribe_weight + config.unsubscribe_weight + config.trigger_weight + config.clear_weight <= 0.0)
+                throw std::invalid_argument("operation weights must be non-negative and not all zero");
+        }
+
+        double percentile(const std::vector<float>& sorted, double fraction)
+        {
+            if (sorted.empty())
+                return 0.0;
+            std::size_t rank = static_cast<std::size_t>(std::ceil(fraction * sorted.size()));
+            return sorted[std::min(sorted.size(), std::max<std::size_t>(rank, 1)) - 1];
+        }
+    }
+
+    LoadReport run(const LoadConfig& config)
+    {
+        check(config);
+
+        cs225::EventDispatcher::get_instance().clear();
+        LoadState state(config);
+        ZipfSampler popularity(config.event_types, config.zipf_exponent);
+
+        std::mt19937_64 setup_random(config.seed);
+        for (std::size_t i = 0; i < config.initial_subscriptions; ++i)
+            state.subscribe(setup_random() % config.listeners, popularity(setup_random));
+
+        std::discrete_distribution<int> mix{config.subscribe_weight, config.unsubscribe_weight,
+                                           config.trigger_weight, config.clear_weight};
+        // the first operations % threads threads make one more
+        const std::size_t per_thread = config.operations / config.threads;
+        const std::size_t remainder = config.operations % config.threads;
+        // time between two operations of the same thread
+        const clock::duration interval = config.rate > 0.0
+            ? std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(config.threads / config.rate))
+            : clock::duration::zero();
+
+        std::vector<std::vector<float>> latencies(config.threads);
+        std::vector<std::thread> workers;
+        const clock::time_point start = clock::now();
+        for (std::size_t t = 0; t < config.threads; ++t)
+        {
+            workers.push_back(std::thread([&, t]()
+            {
+                std::mt19937_64 random(config.seed + t + 1);
+                std::discrete_distribution<int> operations(mix);
+                std::vector<float>& recorded = latencies[t];
+                const std::size_t count = per_thread + (t < remainder ? 1 : 0);
+                recorded.reserve(count);
+
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    // latency counts from the intended issue time when pacing
+                    clock::time_point issued = start + interval * static_cast<clock::rep>(i);
+                    if (interval == clock::duration::zero())
+                        issued = clock::now();
+                    else
+                        std::this_thread::sleep_until(issued);
+
+                    Operation operation = static_cast<Operation>(operations(random));
+                    std::uint64_t draw = random();
+                    {
+                        std::lock_guard<std::mutex> guard(state.lock);
+                        switch (operation)
+                        {
+                            case Operation::subscribe: state.subscribe(draw % config.listeners, popularity(random)); break;
+                            case Operation::unsubscribe: state.unsubscribe(draw); break;
+                            case Operation::trigger: state.trigger(popularity(random)); break;
+                            case Operation::clear: state.clear(); break;
+                        }
+                    }
+                    recorded.push_back(std::chrono::duration<float, std::micro>(clock::now() - issued).count());
+                }
+            }));
+        }
+        for (std::thread& worker : workers)
+            worker.join();
+        const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+        std::vector<float> all;
+        for (const std::vector<float>& recorded : latencies)
+            all.insert(all.end(), recorded.begin(), recorded.end());
+        std::sort(all.begin(), all.end());
+
+        LoadReport report;
+        report.target_rate = config.rate;
+        report.seconds = seconds;
+        report.operations = all.size();
+        report.deliveries = state.deliveries();
+        report.throughput = all.size() / seconds;
+        report.delivery_throughput = report.deliveries / seconds;
+        report.latency_p50 = percentile(all, 0.50);
+        report.latency_p90 = percentile(all, 0.90);
+        report.latency_p99 = percentile(all, 0.99);
+        report.latency_p999 = percentile(all, 0.999);
+        report.latency_max = all.empty() ? 0.0 : all.back();
+        report.mismatched_listeners = state.validate();
+        return report;
+    }
+
+    std::vector<LoadReport> sweep(const LoadConfig& config, std::size_t max_steps)
+    {
+        LoadConfig step = config;
+        if (step.rate <= 0.0)
+            step.rate = 10000.0;
+
+        std::vector<LoadReport> reports;
+        for (std::size_t i = 0; i < max_steps; ++i)
+        {
+            reports.push_back(run(step));
+            if (reports.back().throughput < 0.9 * step.rate)
+                break;
+            step.rate *= 2.0;
+        }
+        return reports;
+    }
+
+    std::ostream& operator<<(std::ostream& os, const LoadReport& report)
+    {
+        os << "target rate:     ";
+        if (report.target_rate > 0.0)
+            os << report.target_rate << " ops/s\n";
+        else
+            os << "unbounded\n";
+        os << "operations:      " << report.operations << " in " << report.seconds << " s\n"
+           << "throughput:      " << report.throughput << " ops/s, " << report.delivery_throughput << " deliveries/s\n"
+           << "latency (us):    p50 " << report.latency_p50 << ", p90 " << report.latency_p90
+           << ", p99 " << report.latency_p99 << ", p99.9 " << report.latency_p999 << ", max " << report.latency_max << "\n"
+           << "validation:      ";
+        if (report.valid())
+            os << "all deliveries match the reference model\n";
+        else
+            os << report.mismatched_listeners << " listeners with unexpected delivery counts\n";
+        return os;
+    }
+}
@@ -0,0 +1,80 @@
+/*!
+ * Randomized load generator for the event dispatcher.
+ *
+ * Builds a population of event types, listeners and subscriptions (event type popularity
+ * follows a Zipf distribution) and drives a random mix of subscribe, unsubscribe, trigger
+ * and clear operations from several threads at a target rate. Every delivery is checked
+ * against a reference model, and the sustained throughput and the operation latencies
+ * (measured from the intended issue time, so queueing delays are not hidden) are reported.
+ *
+ * The dispatcher is not thread-safe: operations are serialized through a lock, which is
+ * what a multi-threaded application would have to do as well.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace loadgen
+{
+    // event types are instantiated at compile time, so the population is bounded
+    const std::size_t max_event_types = 256;
+
+    struct LoadConfig
+    {
+        LoadConfig()
+            : event_types{64}, listeners{1000}, initial_subscriptions{10000}
+            , threads{4}, operations{1000000}, rate{0.0}, zipf_exponent{1.0}, seed{225}
+            , subscribe_weight{10.0}, unsubscribe_weight{10.0}, trigger_weight{80.0}, clear_weight{0.0}
+        {}
+
+        std::size_t event_types;
+        std::size_t listeners;
+        std::size_t initial_subscriptions;
+        std::size_t threads;
+        std::size_t operations;         // in total, split as evenly as possible among the threads
+        double rate;                    // target operations per second in total (0: as fast as possible)
+        double zipf_exponent;           // popularity skew of the event types (0: uniform)
+        std::uint64_t seed;
+
+        // relative frequency of each operation
+        double subscribe_weight;
+        double unsubscribe_weight;
+        double trigger_weight;
+        double clear_weight;
+    };
+
+    struct LoadReport
+    {
+        double target_rate;
+        double seconds;
+        std::size_t operations;
+        std::size_t deliveries;
+        double throughput;              // operations per second
+        double delivery_throughput;     // deliveries per second
+
+        // operation latencies in microseconds
+        double latency_p50;
+        double latency_p90;
+        double latency_p99;
+        double latency_p999;
+        double latency_max;
+
+        // listeners whose delivery count of some event type doesn't match the reference model
+        std::size_t mismatched_listeners;
+        bool valid() const { return mismatched_listeners == 0; }
+    };
+
+    // uses (and leaves cleared) the event dispatcher singleton
+    // throws std::invalid_argument on inconsistent configurations
+    LoadReport run(const LoadConfig& config);
+
+    // runs at doubling target rates (starting at config.rate) until the achieved throughput
+    // falls below 90% of the target: the last reports show the dispatcher's knee point
+    std::vector<LoadReport> sweep(const LoadConfig& config, std::size_t max_steps = 12);
+
+    std::ostream& operator<<(std::ostream& os, const LoadReport& report);
+}
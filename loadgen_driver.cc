@@ -0,0 +1,115 @@
+/*! 
+ * Load generator entry point for the event-driven programming CS225 assignment. 
+ */
+
+#include "load_generator.hh"
+#include "output_coloring.hh"
+
+#include <cstdlib>      // std::atoi, std::atof, std::strtoull
+#include <exception>    // std::exception
+#include <iostream>     // std::cout
+#include <string>       // std::string
+#include <vector>       // std::vector
+
+void print_instructions()
+{
+    static const std::string instructions_message
+    (
+       "Usage instructions: <program-executable> [options]\n"
+       "  --types=N          number of event types (1-256, default 64)\n"
+       "  --listeners=N      number of listeners (default 1000)\n"
+       "  --subscriptions=N  initial number of subscriptions (default 10000)\n"
+       "  --threads=N        number of threads issuing operations (default 4)\n"
+       "  --operations=N     total number of operations (default 1000000)\n"
+       "  --rate=X           target operations per second in total (default: as fast as possible)\n"
+       "  --zipf=X           popularity skew of the event types (default 1.0, 0 is uniform)\n"
+       "  --seed=N           random seed (default 225)\n"
+       "  --mix=S,U,T,C      relative weights of subscribe, unsubscribe, trigger and clear (default 10,10,80,0)\n"
+       "  --sweep            double the target rate until the throughput can't keep up\n"
+       "  -h, --help         display this message\n"
+       "The program returns a non-zero status if a delivery doesn't match the reference model.\n"
+    );
+    std::cout << instructions_message << std::endl;
+}
+
+// parses "S,U,T,C", nothing may follow C
+bool parse_mix( const std::string& text, loadgen::LoadConfig& config )
+{
+    double weights[4];
+    const char* cursor = text.c_str();
+    for( int i = 0; i < 4; ++i )
+    {
+        char* end;
+        weights[i] = std::strtod( cursor, &end );
+        if( end == cursor || *end != ( i < 3 ? ',' : '\0' ) )
+            return false;
+        cursor = end + 1;
+    }
+    config.subscribe_weight = weights[0];
+    config.unsubscribe_weight = weights[1];
+    config.trigger_weight = weights[2];
+    config.clear_weight = weights[3];
+    return true;
+}
+
+int main( int argc, const char** argv )
+{
+    loadgen::LoadConfig config;
+    bool sweep = false;
+    for( int i = 1; i < argc; ++i )
+    {
+        std::string param = argv[i];
+        std::size_t equals = param.find( '=' );
+        std::string name = param.substr( 0, equals );
+        const char* value = equals == std::string::npos ? "" : argv[i] + equals + 1;
+
+        if( name == "--types" )
+            config.event_types = std::strtoull( value, nullptr, 10 );
+        else if( name == "--listeners" )
+            config.listeners = std::strtoull( value, nullptr, 10 );
+        else if( name == "--subscriptions" )
+            config.initial_subscriptions = std::strtoull( value, nullptr, 10 );
+        else if( name == "--threads" )
+            config.threads = std::strtoull( value, nullptr, 10 );
+        else if( name == "--operations" )
+            config.operations = std::strtoull( value, nullptr, 10 );
+        else if( name == "--rate" )
+            config.rate = std::atof( value );
+        else if( name == "--zipf" )
+            config.zipf_exponent = std::atof( value );
+        else if( name == "--seed" )
+            config.seed = std::strtoull( value, nullptr, 10 );
+        else if( name == "--mix" && parse_mix( value, config ) )
+            continue;
+        else if( param == "--sweep" )
+            sweep = true;
+        else
+        {
+            print_instructions();
+            return param == "-h" || param == "--help" ? 0 : 2;
+        }
+    }
+
+    try
+    {
+        std::vector<loadgen::LoadReport> reports;
+        if( sweep )
+            reports = loadgen::sweep( config );
+        else
+            reports.push_back( loadgen::run( config ) );
+
+        bool valid = true;
+        for( const loadgen::LoadReport& report : reports )
+        {
+            std::cout << report << std::endl;
+            valid = valid && report.valid();
+        }
+        if( !valid )
+            print( "Delivery validation failed\n", colors::red );
+        return valid ? 0 : 1;
+
+    } catch( const std::exception& ex ) {
+        print( std::string( "Runtime error exception caught: \n" ) + ex.what() + "\n", colors::red );
+        return 1;
+    }
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cs225
+{
+    // thrown when changing a table that was frozen for lookups (thaw it first)
+    class TableFrozen : public std::logic_error
+    {
+    public:
+        explicit TableFrozen(const std::string& what) : std::logic_error(what)
+        {}
+    };
+
+    // immutable map from 64-bit keys (type hashes) to values, built once for lookups:
+    // every key has a slot of its own in one contiguous array (hash and displace: the keys are
+    // split into buckets, and each bucket gets a seed that sends its keys to free slots), so a
+    // lookup is two array reads and one key comparison, whatever the number of keys
+    template <typename V>
+    class PerfectHashMap
+    {
+    public:
+        PerfectHashMap() : slot_mask{0}, bucket_shift{64}, count{0}
+        {}
+
+        // throws std::invalid_argument on duplicate keys
+        void build(const std::vector<std::pair<std::uint64_t, V>>& entries);
+        void clear()
+        {
+            seeds.clear();
+            slots.clear();
+            count = 0;
+        }
+
+        // null if the key isn't in the map
+        const V* find(std::uint64_t key) const
+        {
+            if (slots.empty())
+                return nullptr;
+            const std::uint64_t mixed = mix(key);
+            const Slot& slot = slots[position(mixed, seeds[bucket(mixed)])];
+            return slot.used && slot.key == key ? &slot.value : nullptr;
+        }
+        // the keys are fixed, the values can be updated in place
+        V* find(std::uint64_t key)
+        {
+            return const_cast<V*>(static_cast<const PerfectHashMap&>(*this).find(key));
+        }
+
+        std::size_t size() const { return count; }
+        bool empty() const { return slots.empty(); }
+        // bytes allocated outside of the object itself
+        std::size_t heap_bytes() const
+        {
+            return seeds.capacity() * sizeof(std::uint32_t) + slots.capacity() * sizeof(Slot);
+        }
+    private:
+        struct Slot
+        {
+            std::uint64_t key;
+            V value;
+            bool used;
+        };
+
+        // the keys are hashes already, but not necessarily well spread in every bit
+        static std::uint64_t mix(std::uint64_t x)
+        {
+            x ^= x >> 30;
+            x *= 0xbf58476d1ce4e5b9ull;
+            x ^= x >> 27;
+            x *= 0x94d049bb133111ebull;
+            return x ^ (x >> 31);
+        }
+        // the high bits pick the bucket, the low bits (mixed with the seed) the slot
+        std::size_t bucket(std::uint64_t mixed) const
+        {
+            return bucket_shift < 64 ? static_cast<std::size_t>(mixed >> bucket_shift) : 0u;
+        }
+        std::size_t position(std::uint64_t mixed, std::uint32_t seed) const
+        {
+            return static_cast<std::size_t>(mix(mixed ^ (seed * 0x9e3779b97f4a7c15ull)) & slot_mask);
+        }
+
+        std::vector<std::uint32_t> seeds;   // per bucket
+        std::vector<Slot> slots;
+        std::uint64_t slot_mask;
+        unsigned bucket_shift;
+        std::size_t count;
+    };
+
+    template <typename V>
+    void PerfectHashMap<V>::build(const std::vector<std::pair<std::uint64_t, V>>& entries)
+    {
+        clear();
+        count = entries.size();
+        if (entries.empty())
+            return;
+
+        std::vector<std::uint64_t> keys;
+        keys.reserve(entries.size());
+        for (const std::pair<std::uint64_t, V>& entry : entries)
+            keys.push_back(entry.first);
+        std::sort(keys.begin(), keys.end());
+        if (std::adjacent_find(keys.begin(), keys.end()) != keys.end())
+            throw std::invalid_argument("duplicate key in a perfect hash map");
+
+        // about 4 keys per bucket, and slots for 1.25 times the keys (rounded up to a power of two)
+        unsigned bucket_bits = 0;
+        while ((std::size_t(1) << bucket_bits) < entries.size() / 4)
+            bucket_bits++;
+        bucket_shift = 64 - bucket_bits;
+        std::size_t slot_count = 1;
+        while (slot_count < entries.size() + entries.size() / 4)
+            slot_count *= 2;
+
+        std::vector<std::vector<std::size_t>> buckets(std::size_t(1) << bucket_bits);
+        for (std::size_t i = 0; i < entries.size(); ++i)
+            buckets[bucket(mix(entries[i].first))].push_back(i);
+        // the largest buckets are the hardest to place, place them first
+        std::vector<std::size_t> order(buckets.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&buckets](std::size_t a, std::size_t b)
+        {
+            return buckets[a].size() > buckets[b].size();
+        });
+
+        const std::uint32_t max_seed = 1u << 16;
+        std::vector<std::size_t> placed;
+        while (true)
+        {
+            slot_mask = slot_count - 1;
+            seeds.assign(buckets.size(), 0u);
+            slots.assign(slot_count, Slot{0u, V(), false});
+
+            bool complete = true;
+            for (std::size_t b : order)
+            {
+                if (buckets[b].empty())
+                    break;
+
+                std::uint32_t seed = 0;
+                for (; seed < max_seed; ++seed)
+                {
+                    placed.clear();
+                    for (std::size_t i : buckets[b])
+                    {
+                        std::size_t slot = position(mix(entries[i].first), seed);
+                        if (slots[slot].used || std::find(placed.begin(), placed.end(), slot) != placed.end())
+                            break;
+                        placed.push_back(slot);
+                    }
+                    if (placed.size() == buckets[b].size())
+                        break;
+                }
+                if (seed == max_seed)
+                {
+                    complete = false;
+                    break;
+                }
+
+                seeds[b] = seed;
+                for (std::size_t k = 0; k < placed.size(); ++k)
+                {
+                    const std::pair<std::uint64_t, V>& entry = entries[buckets[b][k]];
+                    slots[placed[k]] = Slot{entry.first, entry.second, true};
+                }
+            }
+            if (complete)
+                return;
+            // unlucky: start over with more room
+            slot_count *= 2;
+        }
+    }
+}
@@ -0,0 +1,187 @@
+#include "predicate_filter.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define CS225_X86_KERNELS
+    #include <immintrin.h>
+#endif
+
+namespace cs225
+{
+    void SelectionMask::reset(std::size_t row_count)
+    {
+        rows = row_count;
+        bits.assign((row_count + 63) / 64, ~std::uint64_t{0});
+        // rows past the end are never selected
+        if (row_count % 64)
+            bits.back() = (std::uint64_t{1} << (row_count % 64)) - 1;
+    }
+
+    std::size_t SelectionMask::count() const
+    {
+        std::size_t total = 0;
+        for (std::uint64_t word : bits)
+            total += static_cast<std::size_t>(__builtin_popcountll(word));
+        return total;
+    }
+
+    bool SelectionMask::any() const
+    {
+        for (std::uint64_t word : bits)
+        {
+            if (word)
+                return true;
+        }
+        return false;
+    }
+
+    namespace
+    {
+        using KernelFunction = void (*)(const std::int32_t*, std::size_t, std::int32_t, std::int32_t, std::uint64_t*);
+
+        // handles rows [first, count), which may start in the middle of a mask word
+        void filter_range_scalar_from(const std::int32_t* values, std::size_t first, std::size_t count,
+                                      std::int32_t min, std::int32_t max, std::uint64_t* mask)
+        {
+            for (std::size_t row = first; row < count; ++row)
+            {
+                if (values[row] < min || values[row] > max)
+                    mask[row / 64] &= ~(std::uint64_t{1} << (row % 64));
+            }
+        }
+
+        void filter_range_scalar(const std::int32_t* values, std::size_t count, std::int32_t min, std::int32_t max,
+                                 std::uint64_t* mask)
+        {
+            // branch-free, one mask word at a time
+            std::size_t full_words = count / 64;
+            for (std::size_t word = 0; word < full_words; ++word)
+            {
+                const std::int32_t* chunk = values + word * 64;
+                std::uint64_t inside = 0;
+                for (std::size_t bit = 0; bit < 64; ++bit)
+                    inside |= std::uint64_t{chunk[bit] >= min && chunk[bit] <= max} << bit;
+                mask[word] &= inside;
+            }
+            filter_range_scalar_from(values, full_words * 64, count, min, max, mask);
+        }
+
+    #ifdef CS225_X86_KERNELS
+        __attribute__((target("sse2")))
+        void filter_range_sse2(const std::int32_t* values, std::size_t count, std::int32_t min, std::int32_t max,
+                               std::uint64_t* mask)
+        {
+            const __m128i low = _mm_set1_epi32(min);
+            const __m128i high = _mm_set1_epi32(max);
+            std::size_t full_words = count / 64;
+            for (std::size_t word = 0; word < full_words; ++word)
+            {
+                const std::int32_t* chunk = values + word * 64;
+                std::uint64_t outside = 0;
+                for (std::size_t lane = 0; lane < 64; lane += 4)
+                {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chunk + lane));
+                    __m128i out = _mm_or_si128(_mm_cmplt_epi32(v, low), _mm_cmpgt_epi32(v, high));
+                    outside |= static_cast<std::uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(out))) << lane;
+                }
+                mask[word] &= ~outside;
+            }
+            filter_range_scalar_from(values, full_words * 64, count, min, max, mask);
+        }
+
+        __attribute__((target("avx2")))
+        void filter_range_avx2(const std::int32_t* values, std::size_t count, std::int32_t min, std::int32_t max,
+                               std::uint64_t* mask)
+        {
+            const __m256i low = _mm256_set1_epi32(min);
+            const __m256i high = _mm256_set1_epi32(max);
+            std::size_t full_words = count / 64;
+            for (std::size_t word = 0; word < full_words; ++word)
+            {
+                const std::int32_t* chunk = values + word * 64;
+                std::uint64_t outside = 0;
+                for (std::size_t lane = 0; lane < 64; lane += 8)
+                {
+                    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chunk + lane));
+                    __m256i out = _mm256_or_si256(_mm256_cmpgt_epi32(low, v), _mm256_cmpgt_epi32(v, high));
+                    outside |= static_cast<std::uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(out))) << lane;
+                }
+                mask[word] &= ~outside;
+            }
+            filter_range_scalar_from(values, full_words * 64, count, min, max, mask);
+        }
+    #endif
+
+        KernelFunction kernel_function(FilterKernel kernel)
+        {
+            switch (kernel)
+            {
+            #ifdef CS225_X86_KERNELS
+                case FilterKernel::sse2: return &filter_range_sse2;
+                case FilterKernel::avx2: return &filter_range_avx2;
+            #endif
+                default: return &filter_range_scalar;
+            }
+        }
+
+        FilterKernel best_kernel()
+        {
+        #ifdef CS225_X86_KERNELS
+            // may run before the runtime initialized its CPU model
+            __builtin_cpu_init();
+        #endif
+            if (is_supported(FilterKernel::avx2))
+                return FilterKernel::avx2;
+            if (is_supported(FilterKernel::sse2))
+                return FilterKernel::sse2;
+            return FilterKernel::scalar;
+        }
+
+        // chosen during static initialization, before any filtering can happen
+        FilterKernel active_kernel = best_kernel();
+        KernelFunction active_function = kernel_function(active_kernel);
+    }
+
+    bool is_supported(FilterKernel kernel)
+    {
+        switch (kernel)
+        {
+            case FilterKernel::scalar: return true;
+        #ifdef CS225_X86_KERNELS
+            case FilterKernel::sse2: return __builtin_cpu_supports("sse2");
+            case FilterKernel::avx2: return __builtin_cpu_supports("avx2");
+        #endif
+            default: return false;
+        }
+    }
+
+    FilterKernel get_filter_kernel()
+    {
+        return active_kernel;
+    }
+
+    bool set_filter_kernel(FilterKernel kernel)
+    {
+        if (!is_supported(kernel))
+            return false;
+        active_kernel = kernel;
+        active_function = kernel_function(kernel);
+        return true;
+    }
+
+    const char* get_name(FilterKernel kernel)
+    {
+        switch (kernel)
+        {
+            case FilterKernel::scalar: return "scalar";
+            case FilterKernel::sse2: return "sse2";
+            case FilterKernel::avx2: return "avx2";
+        }
+        return "unknown";
+    }
+
+    void filter_range(const std::int32_t* values, std::size_t count, std::int32_t min, std::int32_t max,
+                      std::uint64_t* mask)
+    {
+        active_function(values, count, min, max, mask);
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cs225
+{
+    // one bit per row of a block of events, set for the rows that were selected
+    class SelectionMask
+    {
+    public:
+        SelectionMask() : rows{0}
+        {}
+
+        // selects all the rows
+        void reset(std::size_t row_count);
+
+        std::size_t size() const { return rows; }
+        bool test(std::size_t row) const { return (bits[row / 64] >> (row % 64)) & 1u; }
+        std::size_t count() const;
+        bool any() const;
+
+        // calls f(first, count) for every run of consecutive selected rows
+        template <typename F>
+        void for_each_run(F f) const
+        {
+            std::size_t row = 0;
+            while (row < rows)
+            {
+                while (row < rows && !test(row))
+                    ++row;
+                std::size_t first = row;
+                while (row < rows && test(row))
+                    ++row;
+                if (row > first)
+                    f(first, row - first);
+            }
+        }
+
+        std::uint64_t* words() { return bits.data(); }
+        const std::uint64_t* words() const { return bits.data(); }
+        std::size_t word_count() const { return bits.size(); }
+    private:
+        std::vector<std::uint64_t> bits;
+        std::size_t rows;
+    };
+
+    // restricted predicate form that can be evaluated in bulk:
+    // a conjunction of inclusive ranges over 32-bit integer columns
+    struct RangePredicate
+    {
+        std::size_t column;
+        std::int32_t min;
+        std::int32_t max;
+    };
+
+    class Predicate
+    {
+    public:
+        // adds the condition min <= column <= max
+        Predicate& where(std::size_t column, std::int32_t min, std::int32_t max)
+        {
+            ranges.push_back(RangePredicate{column, min, max});
+            return *this;
+        }
+
+        bool empty() const { return ranges.empty(); }
+        const std::vector<RangePredicate>& get_ranges() const { return ranges; }
+    private:
+        std::vector<RangePredicate> ranges;
+    };
+
+    // filter kernel implementations, the best one supported by the CPU is picked at startup
+    enum class FilterKernel { scalar, sse2, avx2 };
+
+    bool is_supported(FilterKernel kernel);
+    FilterKernel get_filter_kernel();
+    // returns false (and keeps the current one) if the CPU doesn't support the kernel
+    bool set_filter_kernel(FilterKernel kernel);
+    const char* get_name(FilterKernel kernel);
+
+    // clears the bits of the mask for the rows whose value is outside [min, max]
+    void filter_range(const std::int32_t* values, std::size_t count, std::int32_t min, std::int32_t max,
+                      std::uint64_t* mask);
+}
@@ -0,0 +1,247 @@
+#pragma once
+
+#include "event.hh"
+#include "thread_placement.hh"
+#include "type_info.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cs225
+{
+    namespace detail
+    {
+        // header of a pooled event: the reference count lives next to the payload
+        struct SharedEventControl
+        {
+            std::atomic<std::uint32_t> references;
+            TypeInfo type;
+            const Event* event;
+            void (*destroy)(SharedEventControl*);
+        };
+    }
+
+    // reference-counted handle to an immutable event allocated from an EventPool
+    // copies share the same event (no copy of the payload, no allocation), and the last
+    // handle to go away, on whichever thread, destroys it and gives its memory back to the pool
+    class SharedEvent
+    {
+    public:
+        SharedEvent() : control{nullptr}
+        {}
+        explicit SharedEvent(detail::SharedEventControl* shared) : control{shared}
+        {}
+        SharedEvent(const SharedEvent& other) : control{other.control}
+        {
+            if (control)
+                control->references.fetch_add(1, std::memory_order_relaxed);
+        }
+        SharedEvent(SharedEvent&& other) : control{other.control}
+        {
+            other.control = nullptr;
+        }
+        SharedEvent& operator=(SharedEvent other)
+        {
+            std::swap(control, other.control);
+            return *this;
+        }
+        ~SharedEvent()
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            // the release pairs with the acquire of the last owner, so that it sees every use of the event
+            if (control && control->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                control->destroy(control);
+            control = nullptr;
+        }
+
+        const Event& operator*() const { return *control->event; }
+        const Event* operator->() const { return control->event; }
+        const Event* get() const { return control ? control->event : nullptr; }
+        explicit operator bool() const { return control != nullptr; }
+
+        // the dynamic type of the event
+        TypeInfo get_type() const { return control ? control->type : TypeInfo{}; }
+        std::size_t use_count() const { return control ? control->references.load(std::memory_order_relaxed) : 0; }
+
+        template <typename E>
+        const E& as() const { return static_cast<const E&>(*control->event); }
+    private:
+        detail::SharedEventControl* control;
+    };
+
+    // pool of shared events of type E, grown in chunks and never shrunk
+    // there is a free list per NUMA node: threads take events from the list of their node
+    // (see pin_current_thread), and the chunks of a list are allocated (and first touched)
+    // by a thread of that node, so events are built in memory local to their producer
+    // events go back to the list they came from, whichever thread releases them
+    template <typename E>
+    class EventPool
+    {
+    public:
+        static_assert(std::is_base_of<Event, E>::value, "only events can be pooled");
+
+        // one pool per event type; never destroyed, since handles may outlive static destruction
+        static EventPool& get_instance()
+        {
+            static EventPool* instance = new EventPool;
+            return *instance;
+        }
+
+        // constructs the event in place
+        template <typename... Args>
+        SharedEvent make(Args&&... args)
+        {
+            Node* node = acquire();
+            try
+            {
+                node->event = new (&node->storage) E(std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                release(node);
+                throw;
+            }
+            node->references.store(1, std::memory_order_relaxed);
+            return SharedEvent{node};
+        }
+        // constructs the event in place from the E returned by factory: the copy (or move)
+        // of the returned temporary is elided (by every mainstream compiler in C++11, as
+        // required from C++17 on), so factories returning E by value cost no copy
+        template <typename Factory>
+        SharedEvent make_with(Factory&& factory)
+        {
+            Node* node = acquire();
+            try
+            {
+                node->event = new (&node->storage) E(factory());
+            }
+            catch (...)
+            {
+                release(node);
+                throw;
+            }
+            node->references.store(1, std::memory_order_relaxed);
+            return SharedEvent{node};
+        }
+
+        // number of events the pool has memory for, and how many of them are alive
+        std::size_t get_capacity() const
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            std::size_t total = 0;
+            for (const FreeList& list : lists)
+                total += list.capacity;
+            return total;
+        }
+        std::size_t get_in_use() const
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return in_use;
+        }
+        // the capacity of the free list of a node
+        std::size_t get_capacity(std::size_t node) const
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return node < lists.size() ? lists[node].capacity : 0;
+        }
+        static constexpr std::size_t node_size() { return sizeof(Node); }
+    private:
+        struct Node : detail::SharedEventControl
+        {
+            typename std::aligned_storage<sizeof(E), alignof(E)>::type storage;
+            Node* next_free;
+            std::size_t home;   // the free list it belongs to
+        };
+
+        struct FreeList
+        {
+            FreeList() : head{nullptr}, capacity{0}
+            {}
+
+            Node* head;
+            std::size_t capacity;
+        };
+
+        EventPool() : lists(1), in_use{0}
+        {}
+        EventPool(const EventPool&) = delete;
+        EventPool& operator=(const EventPool&) = delete;
+
+        Node* acquire()
+        {
+            const std::size_t home = current_node();
+            std::lock_guard<std::mutex> guard(lock);
+            if (home >= lists.size())
+                lists.resize(home + 1);
+            FreeList& list = lists[home];
+            if (!list.head)
+                grow(list, home);
+            Node* node = list.head;
+            list.head = node->next_free;
+            in_use++;
+            return node;
+        }
+
+        void release(Node* node)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            FreeList& list = lists[node->home];
+            node->next_free = list.head;
+            list.head = node;
+            in_use--;
+        }
+
+        // doubles the capacity of the list (16 events at first)
+        void grow(FreeList& list, std::size_t home)
+        {
+            const std::size_t count = list.capacity ? list.capacity : 16;
+            chunks.emplace_back(new Node[count]);
+            Node* chunk = chunks.back().get();
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                chunk[i].type = type_of<E>();
+                chunk[i].destroy = &EventPool::destroy;
+                chunk[i].next_free = i + 1 < count ? &chunk[i + 1] : list.head;
+                chunk[i].home = home;
+            }
+            list.head = chunk;
+            list.capacity += count;
+        }
+
+        static void destroy(detail::SharedEventControl* control)
+        {
+            Node* node = static_cast<Node*>(control);
+            static_cast<const E*>(node->event)->~E();
+            get_instance().release(node);
+        }
+
+        mutable std::mutex lock;
+        std::vector<FreeList> lists;    // per NUMA node
+        std::vector<std::unique_ptr<Node[]>> chunks;
+        std::size_t in_use;
+    };
+
+    // constructs a shared E from args in the pool of E
+    template <typename E, typename... Args>
+    SharedEvent make_shared_event(Args&&... args)
+    {
+        return EventPool<E>::get_instance().make(std::forward<Args>(args)...);
+    }
+    // constructs a shared E in place from the result of factory, see EventPool::make_with
+    template <typename E, typename Factory>
+    SharedEvent make_shared_event_with(Factory&& factory)
+    {
+        return EventPool<E>::get_instance().make_with(std::forward<Factory>(factory));
+    }
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cs225
+{
+    // generational index into a SlotMap
+    // the index selects a slot, the generation tells whether the slot still holds
+    // the value the key was issued for (erasing a value bumps its slot generation)
+    struct SlotKey
+    {
+        std::uint32_t index;
+        std::uint32_t generation;
+    };
+
+    inline bool operator==(const SlotKey& a, const SlotKey& b)
+    {
+        return a.index == b.index && a.generation == b.generation;
+    }
+    inline bool operator!=(const SlotKey& a, const SlotKey& b)
+    {
+        return !(a == b);
+    }
+
+    // associative container with O(1) insertion, lookup and erasure by key
+    // values are kept densely packed (erasure swaps the last value into the gap),
+    // so iterating them is as cheap as iterating a std::vector
+    template <typename T>
+    class SlotMap
+    {
+    public:
+        using iterator = typename std::vector<T>::iterator;
+        using const_iterator = typename std::vector<T>::const_iterator;
+
+        SlotMap() : free_head{no_slot}
+        {}
+
+        SlotKey insert(const T& value)
+        {
+            std::uint32_t index;
+            if (free_head != no_slot)
+            {
+                // recycle a slot, keeping its (already bumped) generation
+                index = free_head;
+                free_head = slots[index].position;
+            }
+            else
+            {
+                index = static_cast<std::uint32_t>(slots.size());
+                slots.push_back(Slot{0u, 0u});
+            }
+
+            slots[index].position = static_cast<std::uint32_t>(values.size());
+            values.push_back(value);
+            owners.push_back(index);
+            return SlotKey{index, slots[index].generation};
+        }
+
+        bool contains(const SlotKey& key) const
+        {
+            return key.index < slots.size() && slots[key.index].generation == key.generation;
+        }
+
+        T* find(const SlotKey& key)
+        {
+            return contains(key) ? &values[slots[key.index].position] : nullptr;
+        }
+        const T* find(const SlotKey& key) const
+        {
+            return contains(key) ? &values[slots[key.index].position] : nullptr;
+        }
+
+        // returns false if the key is stale (already erased or cleared)
+        bool erase(const SlotKey& key)
+        {
+            if (!contains(key))
+                return false;
+            erase_at(slots[key.index].position);
+            return true;
+        }
+
+        // erase the value stored at the given dense position
+        void erase_at(std::size_t position)
+        {
+            std::uint32_t index = owners[position];
+
+            // move the last value into the gap and fix up its slot
+            std::size_t last = values.size() - 1;
+            if (position != last)
+            {
+                values[position] = values[last];
+                owners[position] = owners[last];
+                slots[owners[position]].position = static_cast<std::uint32_t>(position);
+            }
+            values.pop_back();
+            owners.pop_back();
+
+            release_slot(index);
+        }
+
+        // key of the value stored at the given dense position
+        SlotKey key_at(std::size_t position) const
+        {
+            std::uint32_t index = owners[position];
+            return SlotKey{index, slots[index].generation};
+        }
+
+        // erases every value; all the keys issued so far become stale
+        void clear()
+        {
+            for (std::uint32_t index : owners)
+                release_slot(index);
+            values.clear();
+            owners.clear();
+        }
+
+        std::size_t size() const { return values.size(); }
+        bool empty() const { return values.empty(); }
+
+        T& operator[](std::size_t position) { return values[position]; }
+        const T& operator[](std::size_t position) const { return values[position]; }
+
+        iterator begin() { return values.begin(); }
+        iterator end() { return values.end(); }
+        const_iterator begin() const { return values.begin(); }
+        const_iterator end() const { return values.end(); }
+
+    private:
+        static const std::uint32_t no_slot = 0xffffffffu;
+
+        struct Slot
+        {
+            std::uint32_t generation;
+            // dense position while the slot is in use, next free slot otherwise
+            std::uint32_t position;
+        };
+
+        void release_slot(std::uint32_t index)
+        {
+            slots[index].generation++;
+            slots[index].position = free_head;
+            free_head = index;
+        }
+
+        std::vector<Slot> slots;
+        std::vector<T> values;
+        std::vector<std::uint32_t> owners; // dense position -> slot index
+        std::uint32_t free_head;
+    };
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "slot_map.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace cs225
+{
+    // 32-bit index into a table of listeners; 0 stands for no listener
+    using ListenerHandle = std::uint32_t;
+
+    // SlotMap of listener handles laid out for memory: the values, their owners and the
+    // slots share a single allocation (16 bytes per subscription), and lists of up to
+    // inline_capacity subscriptions don't allocate at all
+    // keys and iteration behave as in SlotMap (values are densely packed)
+    class SubscriberList
+    {
+    public:
+        using iterator = ListenerHandle*;
+        using const_iterator = const ListenerHandle*;
+
+        static const std::uint32_t inline_capacity = 2;
+
+        SubscriberList() : count{0}, slot_count{0}, capacity{inline_capacity}, free_head{no_slot}
+        {}
+        SubscriberList(const SubscriberList&) = delete;
+        SubscriberList& operator=(const SubscriberList&) = delete;
+        ~SubscriberList()
+        {
+            if (!is_inline())
+                delete[] storage.heap;
+        }
+
+        SlotKey insert(ListenerHandle value)
+        {
+            std::uint32_t index;
+            if (free_head != no_slot)
+            {
+                // recycle a slot, keeping its (already bumped) generation
+                index = free_head;
+                free_head = positions()[index];
+            }
+            else
+            {
+                if (slot_count == capacity)
+                    grow();
+                index = slot_count++;
+                generations()[index] = 0u;
+            }
+
+            positions()[index] = count;
+            values()[count] = value;
+            owners()[count] = index;
+            count++;
+            return SlotKey{index, generations()[index]};
+        }
+
+        bool contains(const SlotKey& key) const
+        {
+            return key.index < slot_count && generations()[key.index] == key.generation;
+        }
+
+        ListenerHandle* find(const SlotKey& key)
+        {
+            return contains(key) ? &values()[positions()[key.index]] : nullptr;
+        }
+        const ListenerHandle* find(const SlotKey& key) const
+        {
+            return contains(key) ? &values()[positions()[key.index]] : nullptr;
+        }
+
+        // returns false if the key is stale (already erased or cleared)
+        bool erase(const SlotKey& key)
+        {
+            if (!contains(key))
+                return false;
+            erase_at(positions()[key.index]);
+            return true;
+        }
+
+        // erase the value stored at the given dense position
+        void erase_at(std::size_t position)
+        {
+            std::uint32_t index = owners()[position];
+
+            // move the last value into the gap and fix up its slot
+            std::uint32_t last = count - 1;
+            if (position != last)
+            {
+                values()[position] = values()[last];
+                owners()[position] = owners()[last];
+                positions()[owners()[position]] = static_cast<std::uint32_t>(position);
+            }
+            count--;
+
+            release_slot(index);
+        }
+
+        // key of the value stored at the given dense position
+        SlotKey key_at(std::size_t position) const
+        {
+            std::uint32_t index = owners()[position];
+            return SlotKey{index, generations()[index]};
+        }
+
+        // erases every value; all the keys issued so far become stale
+        void clear()
+        {
+            for (std::uint32_t position = 0; position < count; ++position)
+                release_slot(owners()[position]);
+            count = 0;
+        }
+
+        std::size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        ListenerHandle& operator[](std::size_t position) { return values()[position]; }
+        const ListenerHandle& operator[](std::size_t position) const { return values()[position]; }
+
+        iterator begin() { return values(); }
+        iterator end() { return values() + count; }
+        const_iterator begin() const { return values(); }
+        const_iterator end() const { return values() + count; }
+
+        // gives the growth slack back (slots that were ever used are kept, free or not)
+        void shrink_to_fit()
+        {
+            if (!is_inline() && slot_count < capacity)
+                reallocate(slot_count > inline_capacity ? slot_count : inline_capacity);
+        }
+
+        // bytes allocated outside of the object itself
+        std::size_t heap_bytes() const
+        {
+            return is_inline() ? 0 : capacity * words_per_slot * sizeof(std::uint32_t);
+        }
+    private:
+        static const std::uint32_t no_slot = 0xffffffffu;
+        // value, owner, generation and position
+        static const std::uint32_t words_per_slot = 4;
+
+        bool is_inline() const { return capacity == inline_capacity; }
+
+        // the four arrays are stored one after the other, capacity words each:
+        // values and owners are indexed by dense position, generations and positions by slot index
+        // (a free slot's position is the next free slot)
+        std::uint32_t* words() { return is_inline() ? storage.local : storage.heap; }
+        const std::uint32_t* words() const { return is_inline() ? storage.local : storage.heap; }
+        ListenerHandle* values() { return words(); }
+        const ListenerHandle* values() const { return words(); }
+        std::uint32_t* owners() { return words() + capacity; }
+        const std::uint32_t* owners() const { return words() + capacity; }
+        std::uint32_t* generations() { return words() + 2 * capacity; }
+        const std::uint32_t* generations() const { return words() + 2 * capacity; }
+        std::uint32_t* positions() { return words() + 3 * capacity; }
+        const std::uint32_t* positions() const { return words() + 3 * capacity; }
+
+        // grows by half (the slack stays around 25% on average)
+        void grow()
+        {
+            reallocate(std::max<std::uint32_t>(capacity + capacity / 2, 4u));
+        }
+
+        // moves the arrays to storage for new_capacity slots (inline if it is inline_capacity)
+        void reallocate(std::uint32_t new_capacity)
+        {
+            // the inline words and the heap pointer overlap, save them first
+            std::uint32_t local[inline_capacity * words_per_slot];
+            std::uint32_t* old_words = local;
+            if (is_inline())
+                std::copy(storage.local, storage.local + inline_capacity * words_per_slot, local);
+            else
+                old_words = storage.heap;
+
+            std::uint32_t* new_words = new_capacity == inline_capacity ? storage.local : new std::uint32_t[new_capacity * words_per_slot];
+            for (std::uint32_t array = 0; array < words_per_slot; ++array)
+                std::copy(old_words + array * capacity, old_words + array * capacity + slot_count, new_words + array * new_capacity);
+
+            if (!is_inline())
+                delete[] old_words;
+            if (new_capacity != inline_capacity)
+                storage.heap = new_words;
+            capacity = new_capacity;
+        }
+
+        void release_slot(std::uint32_t index)
+        {
+            generations()[index]++;
+            positions()[index] = free_head;
+            free_head = index;
+        }
+
+        std::uint32_t count;
+        std::uint32_t slot_count;
+        std::uint32_t capacity;
+        std::uint32_t free_head;
+        union
+        {
+            std::uint32_t* heap;
+            std::uint32_t local[inline_capacity * words_per_slot];
+        } storage;
+    };
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "slot_map.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cs225
+{
+    // the event types a listener is subscribed to: a bitset of type slots (dense type indices)
+    // plus the key of each subscription, stored in the order of the set bits
+    // types in the first 64 slots don't allocate for their bits
+    class SubscriptionSet
+    {
+    public:
+        SubscriptionSet() : low{0}
+        {}
+
+        bool contains(std::uint32_t slot) const
+        {
+            return (word(slot) >> (slot % 64)) & 1u;
+        }
+
+        // the key of the subscription to the type in slot, null if there is none
+        const SlotKey* find(std::uint32_t slot) const
+        {
+            return contains(slot) ? &keys[rank(slot)] : nullptr;
+        }
+
+        // the slot must not be in the set already
+        void insert(std::uint32_t slot, const SlotKey& key)
+        {
+            keys.insert(keys.begin() + rank(slot), key);
+            if (slot < 64)
+            {
+                low |= std::uint64_t(1) << slot;
+                return;
+            }
+            if (high.size() <= slot / 64 - 1)
+                high.resize(slot / 64, 0u);
+            high[slot / 64 - 1] |= std::uint64_t(1) << (slot % 64);
+        }
+
+        // returns false if the slot wasn't in the set
+        bool erase(std::uint32_t slot)
+        {
+            if (!contains(slot))
+                return false;
+            keys.erase(keys.begin() + rank(slot));
+            if (slot < 64)
+                low &= ~(std::uint64_t(1) << slot);
+            else
+                high[slot / 64 - 1] &= ~(std::uint64_t(1) << (slot % 64));
+            return true;
+        }
+
+        // calls function(slot, key) for every subscription, by increasing slot
+        template <typename Function>
+        void for_each(Function function) const
+        {
+            std::size_t position = 0;
+            for (std::size_t w = 0; w <= high.size(); ++w)
+            {
+                std::uint64_t bits = w == 0 ? low : high[w - 1];
+                while (bits != 0)
+                {
+                    const std::uint32_t slot = static_cast<std::uint32_t>(w * 64 + __builtin_ctzll(bits));
+                    function(slot, keys[position++]);
+                    bits &= bits - 1;
+                }
+            }
+        }
+
+        void clear()
+        {
+            low = 0;
+            high.clear();
+            keys.clear();
+        }
+
+        std::size_t size() const { return keys.size(); }
+        bool empty() const { return keys.empty(); }
+
+        // bytes allocated outside of the object itself
+        std::size_t heap_bytes() const
+        {
+            return high.capacity() * sizeof(std::uint64_t) + keys.capacity() * sizeof(SlotKey);
+        }
+    private:
+        std::uint64_t word(std::uint32_t slot) const
+        {
+            if (slot < 64)
+                return low;
+            return slot / 64 - 1 < high.size() ? high[slot / 64 - 1] : 0u;
+        }
+
+        // the set bits below slot
+        std::size_t rank(std::uint32_t slot) const
+        {
+            const std::uint64_t below = (std::uint64_t(1) << (slot % 64)) - 1;
+            std::size_t count = __builtin_popcountll(word(slot) & below);
+            if (slot >= 64)
+            {
+                count += __builtin_popcountll(low);
+                for (std::size_t w = 0; w + 1 < slot / 64 && w < high.size(); ++w)
+                    count += __builtin_popcountll(high[w]);
+            }
+            return count;
+        }
+
+        std::uint64_t low;                  // slots 0 to 63
+        std::vector<std::uint64_t> high;    // slots 64 and up
+        std::vector<SlotKey> keys;
+    };
+}
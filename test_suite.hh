@@ -411,7 +411,7 @@ TEST( "Event dispatcher implements the singleton pattern",
 
     SUCCEED();
 }
-/*
+
 // more dummy classes for testing purposes
 struct EverythingIsOnFireEvent : public cs225::Event {};
 struct MyPhoneIsVibratingEvent : public cs225::Event {};
@@ -571,6 +571,2044 @@ TEST( "Objects can unsubscribe from events they were subscribed to",
 }
 
 
+// [ Test #17 ] -------------------------------------------------------
+TEST( "Subscriptions return tokens for constant time unsubscription",
+      "Subscribing returns a token (a generational index into the subscriber collection). Unsubscribing through the token removes that subscription only, and a token that was already used or cleared becomes stale." )
+{
+    EventListenerWithCounter counted_listener_1, counted_listener_2, counted_listener_3;
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+
+    cs225::SubscriptionToken token_1 = event_dispatcher.subscribe( counted_listener_1, cs225::type_of<DummyEvent>() );
+    cs225::SubscriptionToken token_2 = event_dispatcher.subscribe( counted_listener_2, cs225::type_of<DummyEvent>() );
+    event_dispatcher.subscribe( counted_listener_3, cs225::type_of<DummyEvent>() );
+
+    // removing the first subscriber must not disturb the others
+    ASSERT_THAT( event_dispatcher.unsubscribe( token_1 ) );
+    cs225::trigger_event( DummyEvent() );
+
+    ASSERT_THAT( counted_listener_1.times_called == 0u );
+    ASSERT_THAT( counted_listener_2.times_called == 1u );
+    ASSERT_THAT( counted_listener_3.times_called == 1u );
+
+    // a used token is stale, even if its slot gets recycled by a new subscription
+    event_dispatcher.subscribe( counted_listener_1, cs225::type_of<DummyEvent>() );
+    ASSERT_THAT( !event_dispatcher.unsubscribe( token_1 ) );
+    cs225::trigger_event( DummyEvent() );
+
+    ASSERT_THAT( counted_listener_1.times_called == 1u );
+
+    // clearing the dispatcher invalidates all the outstanding tokens
+    event_dispatcher.clear();
+    event_dispatcher.subscribe( counted_listener_2, cs225::type_of<DummyEvent>() );
+    ASSERT_THAT( !event_dispatcher.unsubscribe( token_2 ) );
+
+    event_dispatcher.clear();
+}
+
+// [ Test #18 ] -------------------------------------------------------
+TEST( "Scoped subscriptions unsubscribe on destruction",
+      "A scoped subscription is a move-only handle that owns a subscription token. When the handle is destroyed (or reset) the subscription is removed, so no dangling listener pointers are left in the dispatcher." )
+{
+    EventListenerWithCounter counted_listener;
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+
+    cs225::ScopedSubscription outer;
+    {
+        cs225::ScopedSubscription inner = event_dispatcher.subscribe_scoped( counted_listener, cs225::type_of<DummyEvent>() );
+        cs225::trigger_event( DummyEvent() );
+        ASSERT_THAT( counted_listener.times_called == 1u );
+
+        // ownership moves out of the scope, the subscription survives
+        outer = std::move( inner );
+        ASSERT_THAT( !inner );
+    }
+    cs225::trigger_event( DummyEvent() );
+    ASSERT_THAT( counted_listener.times_called == 2u );
+
+    outer.reset();
+    cs225::trigger_event( DummyEvent() );
+    ASSERT_THAT( counted_listener.times_called == 2u );
+
+    // nothing is left behind
+    std::stringstream ss;
+    ss << event_dispatcher;
+    ASSERT_THAT( ss.str() == "" );
+}
+
+
+// Listener that changes the dispatcher subscriptions from inside its handler
+struct MutatingListener : public cs225::Listener
+{
+    MutatingListener( cs225::Listener & other )
+        : victim(other), times_called(0u) {}
+
+    virtual void handle_event( const cs225::Event & )
+    {
+        cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+        times_called++;
+        // subscribe the other listener and unsubscribe ourselves while the event is being dispatched
+        event_dispatcher.subscribe( victim, cs225::type_of<DummyEvent>() );
+        event_dispatcher.unsubscribe( *this, cs225::type_of<DummyEvent>() );
+    }
+
+    cs225::Listener & victim;
+    unsigned int times_called;
+};
+
+// unsubscribes a token twice, and a subscription of its own making twice, while dispatching
+struct TwiceUnsubscriber : public cs225::Listener
+{
+    TwiceUnsubscriber( cs225::Listener & other )
+        : victim(other), results() {}
+
+    virtual void handle_event( const cs225::Event & )
+    {
+        cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+        results.push_back( event_dispatcher.unsubscribe( token ) );
+        results.push_back( event_dispatcher.unsubscribe( token ) );
+        cs225::SubscriptionToken buffered = event_dispatcher.subscribe( victim, cs225::type_of<DummyEvent>() );
+        results.push_back( event_dispatcher.unsubscribe( buffered ) );
+        results.push_back( event_dispatcher.unsubscribe( buffered ) );
+    }
+
+    cs225::Listener & victim;
+    cs225::SubscriptionToken token;
+    std::vector<bool> results;
+};
+
+// [ Test #19 ] -------------------------------------------------------
+TEST( "Subscription changes made during dispatch are deferred",
+      "Subscribing or unsubscribing from inside a handler must not disturb the dispatch in progress. The changes are buffered and applied once the outermost dispatch finishes: new subscribers don't receive the event in flight." )
+{
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+    EventListenerWithCounter counted_listener;
+    MutatingListener mutating_listener( counted_listener );
+
+    event_dispatcher.subscribe( mutating_listener, cs225::type_of<DummyEvent>() );
+
+    cs225::trigger_event( DummyEvent() );
+    ASSERT_THAT( mutating_listener.times_called == 1u );
+    ASSERT_THAT( counted_listener.times_called == 0u );
+
+    // the changes are in place for the next dispatch
+    cs225::trigger_event( DummyEvent() );
+    ASSERT_THAT( mutating_listener.times_called == 1u );
+    ASSERT_THAT( counted_listener.times_called == 1u );
+    event_dispatcher.clear();
+
+    // a token is stale once unsubscribed, even before the dispatch is over
+    EventListenerWithCounter other_listener;
+    TwiceUnsubscriber unsubscriber( other_listener );
+    event_dispatcher.subscribe( unsubscriber, cs225::type_of<DummyEvent>() );
+    unsubscriber.token = event_dispatcher.subscribe( counted_listener, cs225::type_of<DummyEvent>() );
+    cs225::trigger_event( DummyEvent() );
+    ASSERT_THAT( unsubscriber.results == std::vector<bool>( { true, false, true, false } ) );
+    ASSERT_THAT( counted_listener.times_called == 1u && other_listener.times_called == 0u );
+    ASSERT_THAT( !event_dispatcher.is_subscribed( counted_listener, cs225::type_of<DummyEvent>() ) );
+    ASSERT_THAT( !event_dispatcher.is_subscribed( other_listener, cs225::type_of<DummyEvent>() ) );
+
+    event_dispatcher.clear();
+}
+
+struct PingEvent : public cs225::Event {};
+struct PongEvent : public cs225::Event {};
+
+// Listener that records the order of the events it sees, and answers each ping with a pong
+struct PingPongListener : public cs225::Listener
+{
+    virtual void handle_event( const cs225::Event & event )
+    {
+        if( cs225::type_of(event) == cs225::type_of<PingEvent>() )
+        {
+            log += "ping>";
+            cs225::trigger_event( PongEvent() );
+            log += "<ping ";
+        }
+        else
+            log += "pong ";
+    }
+
+    std::string log;
+};
+
+// [ Test #20 ] -------------------------------------------------------
+TEST( "Events triggered from handlers follow the reentrancy policy",
+      "An event triggered while another one is being dispatched is either dispatched immediately (nested), queued until the outermost dispatch finishes, or dispatched immediately up to a nesting limit." )
+{
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+    PingPongListener listener;
+    event_dispatcher.subscribe( listener, cs225::type_of<PingEvent>() );
+    event_dispatcher.subscribe( listener, cs225::type_of<PongEvent>() );
+
+    cs225::trigger_event( PingEvent() );
+    ASSERT_THAT( listener.log == "ping>pong <ping " );
+
+    listener.log.clear();
+    event_dispatcher.set_reentrancy_policy( cs225::ReentrancyPolicy::queued );
+    cs225::trigger_event( PingEvent() );
+    ASSERT_THAT( listener.log == "ping><ping pong " );
+
+    // at depth 1 the limit is already reached
+    listener.log.clear();
+    event_dispatcher.set_reentrancy_policy( cs225::ReentrancyPolicy::depth_limited, 1u );
+    cs225::trigger_event( PingEvent() );
+    ASSERT_THAT( listener.log == "ping><ping pong " );
+
+    listener.log.clear();
+    event_dispatcher.set_reentrancy_policy( cs225::ReentrancyPolicy::depth_limited, 2u );
+    cs225::trigger_event( PingEvent() );
+    ASSERT_THAT( listener.log == "ping>pong <ping " );
+
+    event_dispatcher.set_reentrancy_policy( cs225::ReentrancyPolicy::immediate );
+    event_dispatcher.clear();
+}
+
+
 } // namespace EventDispatcher
 } // namespace Tests
-*/
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include "load_generator.hh" // loadgen::LoadConfig, loadgen::run
+
+/*********************************************************************
+ *                       Load generator tests                        *
+ *********************************************************************/
+
+namespace Tests { namespace LoadGenerator
+{
+
+// [ Test #21 ] -------------------------------------------------------
+TEST( "Randomized load matches the reference delivery model",
+      "Under a random interleaving of subscribe, unsubscribe, trigger and clear operations issued from several threads, every listener must receive exactly the events it was subscribed to when they were triggered." )
+{
+    loadgen::LoadConfig config;
+    config.event_types = 16;
+    config.listeners = 50;
+    config.initial_subscriptions = 200;
+    config.threads = 2;
+    config.operations = 20000;
+    config.clear_weight = 0.1;
+
+    loadgen::LoadReport report = loadgen::run( config );
+
+    ASSERT_THAT( report.operations == config.operations );
+    ASSERT_THAT( report.deliveries > 0u );
+    ASSERT_THAT( report.valid() );
+}
+
+} // namespace LoadGenerator
+} // namespace Tests
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include "type_info.hh"  // cs225::type_hash, cs225::TypeRegistry
+
+/*********************************************************************
+ *                          Type hash tests                          *
+ *********************************************************************/
+
+namespace Tests { namespace TypeHash
+{
+
+struct Widget {};
+struct Gadget {};
+struct Base { virtual ~Base() {} };
+struct Derived : public Base {};
+// never named statically, so never registered
+struct Unnamed : public Base {};
+struct StrangerEvent : public cs225::Event {};
+
+struct StrangerListener : public cs225::Listener
+{
+    StrangerListener()
+        : count(0) {}
+    virtual void handle_event( const cs225::Event & ) { count++; }
+    int count;
+};
+
+// [ Test #22 ] -------------------------------------------------------
+TEST( "Type hashes are computed at compile time from the type name",
+      "The stable identity of a type is a 64-bit hash of its fully qualified name, so it can be used in constant expressions and it means the same in every process that uses the type. Types only seen through a base class reference must have been registered to be handled or subscribed to; events of other types are not delivered." )
+{
+    constexpr std::uint64_t widget_hash = cs225::type_hash<Widget>();
+    static_assert( widget_hash == cs225::fnv1a( "Tests::TypeHash::Widget" ), "the hash only depends on the type name" );
+    static_assert( cs225::type_hash<Widget>() != cs225::type_hash<Gadget>(), "different types have different hashes" );
+
+    ASSERT_THAT( cs225::type_name<Widget>() == "Tests::TypeHash::Widget" );
+    ASSERT_THAT( cs225::type_of<Widget>().get_hash() == widget_hash );
+    ASSERT_THAT( cs225::type_of<const Widget>() == cs225::type_of<Widget>() );
+
+    // a dynamic type seen through a base class reference is resolved through the registry
+    Derived derived;
+    const Base & base = derived;
+    ASSERT_THAT( cs225::type_of( base ) == cs225::type_of<Derived>() );
+    ASSERT_THAT( cs225::type_of( base ).get_hash() == cs225::type_hash<Derived>() );
+
+    // the hash of an unregistered type can't be rebuilt at run time
+    Unnamed unnamed;
+    const Base & unknown = unnamed;
+    ASSERT_THAT( !cs225::type_of( unknown ).is_registered() );
+    ASSERT_THAT( cs225::type_of( base ).is_registered() );
+    try
+    {
+        cs225::TypeInfo info( typeid(Unnamed) );
+        FAIL();
+    }
+    catch( const cs225::UnregisteredType & ) {}
+
+    // nothing handles or subscribes to an unregistered event type, so its events go nowhere
+    StrangerEvent stranger;
+    const cs225::Event & strange = stranger;
+    cs225::EventHandler handler;
+    handler.handle( strange );
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+    event_dispatcher.clear();
+    StrangerListener listener;
+    event_dispatcher.subscribe( listener, cs225::type_of<cs225::Event>() );
+    cs225::trigger_event( strange );
+    ASSERT_THAT( listener.count == 0 );
+    try
+    {
+        event_dispatcher.subscribe( listener, cs225::type_of( strange ) );
+        FAIL();
+    }
+    catch( const cs225::UnregisteredType & ) {}
+    event_dispatcher.clear();
+}
+
+// [ Test #23 ] -------------------------------------------------------
+TEST( "Type hashes round trip through the type registry",
+      "A type can be rebuilt from its hash (e.g. after reading it from a stream), as long as it was registered. Registering a different type under a hash that is already taken is a collision." )
+{
+    cs225::TypeInfo widget_info = cs225::type_of<Widget>();
+    cs225::TypeInfo restored = cs225::TypeInfo::from_hash( widget_info.get_hash() );
+
+    ASSERT_THAT( restored == widget_info );
+    ASSERT_THAT( restored.get_type_info() == typeid(Widget) );
+    ASSERT_THAT( cs225::TypeRegistry::name_of( widget_info.get_hash() ) == "Tests::TypeHash::Widget" );
+
+    // registering the same type twice is fine
+    ASSERT_THAT( cs225::TypeRegistry::register_type( typeid(Widget), widget_info.get_hash(), "Tests::TypeHash::Widget" ) );
+
+    try
+    {
+        cs225::TypeRegistry::register_type( typeid(Gadget), widget_info.get_hash(), "Tests::TypeHash::Gadget" );
+        FAIL();
+    }
+    catch( const cs225::TypeHashCollision & ) {}
+
+    try
+    {
+        cs225::TypeInfo::from_hash( cs225::fnv1a( "not a registered type" ) );
+        FAIL();
+    }
+    catch( const std::out_of_range & ) {}
+}
+
+} // namespace TypeHash
+} // namespace Tests
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include "columnar_stream.hh" // cs225::ColumnLayout, cs225::ColumnBlock, cs225::ColumnarStream
+#include "predicate_filter.hh" // cs225::Predicate, cs225::SelectionMask, cs225::filter_range
+
+#include <cstdint>      // std::int32_t
+#include <limits>       // std::numeric_limits
+#include <stdexcept>    // std::invalid_argument
+
+/*********************************************************************
+ *                      Columnar stream tests                        *
+ *********************************************************************/
+
+namespace cs225
+{
+
+// mouse clicks opt in to columnar streams: one column per coordinate
+template <>
+struct ColumnLayout<Tests::Events::MouseClickedEvent>
+{
+    using block_type = ColumnBlock<int, int>;
+
+    static void append( block_type & block, const Tests::Events::MouseClickedEvent & event )
+    {
+        block.append( event.position.x, event.position.y );
+    }
+};
+
+} // namespace cs225
+
+namespace Tests { namespace Columnar
+{
+
+using Tests::Events::MouseClickedEvent;
+
+// Columnar listener that records the block sizes and the sum of each column
+struct ClickSummer : public cs225::ColumnarListener<MouseClickedEvent>
+{
+    ClickSummer()
+        : sum_x(0), sum_y(0) {}
+
+    virtual void handle_block( const view_type & clicks )
+    {
+        const int * x = clicks.column<0>();
+        const int * y = clicks.column<1>();
+        for( std::size_t i = 0; i < clicks.size(); ++i )
+        {
+            sum_x += x[i];
+            sum_y += y[i];
+        }
+        block_sizes.push_back( clicks.size() );
+    }
+
+    long sum_x, sum_y;
+    std::vector<std::size_t> block_sizes;
+};
+
+// on its first block, unsubscribes a listener and subscribes another one
+struct ClickRearranger : public cs225::ColumnarListener<MouseClickedEvent>
+{
+    ClickRearranger( cs225::ColumnarStream<MouseClickedEvent> & s, ClickSummer & n )
+        : stream(&s), newcomer(&n), unsubscribed(false), blocks(0) {}
+
+    virtual void handle_block( const view_type & )
+    {
+        if( blocks++ == 0 )
+        {
+            unsubscribed = stream->unsubscribe( victim );
+            stream->subscribe( *newcomer );
+        }
+    }
+
+    cs225::ColumnarStream<MouseClickedEvent> * stream;
+    ClickSummer * newcomer;
+    cs225::SlotKey victim;
+    bool unsubscribed;
+    int blocks;
+};
+
+// [ Test #24 ] -------------------------------------------------------
+TEST( "Columnar streams deliver whole blocks of events",
+      "A columnar stream stores the fields of its events in one array per field, and hands full blocks (or the pending events, on flush) to its columnar listeners as column views. Handlers may subscribe and unsubscribe while a block is delivered." )
+{
+    cs225::ColumnarStream<MouseClickedEvent> clicks( 4u );
+    ClickSummer summer, other;
+
+    clicks.subscribe( summer );
+    cs225::SlotKey other_key = clicks.subscribe( other );
+
+    for( int i = 0; i < 6; ++i )
+        clicks.push( MouseClickedEvent( i, 10 * i ) );
+
+    // a full block was delivered, two events are pending
+    ASSERT_THAT( summer.block_sizes.size() == 1u && summer.block_sizes[0] == 4u );
+    ASSERT_THAT( clicks.pending() == 2u );
+
+    // events can also be appended column by column, without building the event object
+    ASSERT_THAT( clicks.unsubscribe( other_key ) );
+    clicks.append( 100, 1000 );
+    clicks.flush();
+
+    ASSERT_THAT( summer.block_sizes.size() == 2u && summer.block_sizes[1] == 3u );
+    ASSERT_THAT( summer.sum_x == 0 + 1 + 2 + 3 + 4 + 5 + 100 );
+    ASSERT_THAT( summer.sum_y == 10 * ( 0 + 1 + 2 + 3 + 4 + 5 ) + 1000 );
+    ASSERT_THAT( other.sum_x == 0 + 1 + 2 + 3 );
+
+    // flushing an empty stream delivers nothing
+    clicks.flush();
+    ASSERT_THAT( summer.block_sizes.size() == 2u );
+
+    // subscriptions changed by a handler apply from the rest of the block (unsubscribing)
+    // or the next one (subscribing)
+    cs225::ColumnarStream<MouseClickedEvent> moves( 2u );
+    ClickSummer victim, newcomer;
+    ClickRearranger rearranger( moves, newcomer );
+    moves.subscribe( rearranger );
+    rearranger.victim = moves.subscribe( victim );
+    moves.push( MouseClickedEvent( 1, 2 ) );
+    moves.push( MouseClickedEvent( 3, 4 ) );
+    ASSERT_THAT( rearranger.unsubscribed && victim.block_sizes.empty() && newcomer.block_sizes.empty() );
+    ASSERT_THAT( !moves.unsubscribe( rearranger.victim ) );
+    moves.push( MouseClickedEvent( 5, 6 ) );
+    moves.push( MouseClickedEvent( 7, 8 ) );
+    ASSERT_THAT( rearranger.blocks == 2 && victim.block_sizes.empty() );
+    ASSERT_THAT( newcomer.block_sizes.size() == 1u && newcomer.sum_x == 5 + 7 );
+}
+
+// [ Test #25 ] -------------------------------------------------------
+TEST( "SIMD filter kernels agree with the scalar kernel",
+      "Every filter kernel supported by the CPU must select exactly the rows whose value lies inside the inclusive range, including blocks whose size is not a multiple of the vector width and values at the limits of the integer range." )
+{
+    const cs225::FilterKernel original = cs225::get_filter_kernel();
+    const cs225::FilterKernel kernels[] = { cs225::FilterKernel::scalar, cs225::FilterKernel::sse2, cs225::FilterKernel::avx2 };
+
+    std::vector<std::int32_t> values;
+    for( int i = 0; i < 203; ++i )
+        values.push_back( ( i * 7919 ) % 401 - 200 );
+    values[5] = std::numeric_limits<std::int32_t>::min();
+    values[77] = std::numeric_limits<std::int32_t>::max();
+    values[130] = -50; // the range limits are inclusive
+    values[131] = 50;
+
+    for( cs225::FilterKernel kernel : kernels )
+    {
+        if( !cs225::set_filter_kernel( kernel ) )
+            continue; // not supported by this CPU
+
+        for( std::size_t count : { std::size_t(0), std::size_t(3), std::size_t(64), std::size_t(203) } )
+        {
+            cs225::SelectionMask mask;
+            mask.reset( count );
+            cs225::filter_range( values.data(), count, -50, 50, mask.words() );
+
+            std::size_t expected = 0;
+            for( std::size_t row = 0; row < count; ++row )
+            {
+                bool inside = values[row] >= -50 && values[row] <= 50;
+                expected += inside;
+                ASSERT_THAT( mask.test( row ) == inside );
+            }
+            ASSERT_THAT( mask.count() == expected );
+        }
+    }
+
+    cs225::set_filter_kernel( original );
+}
+
+// [ Test #26 ] -------------------------------------------------------
+TEST( "Columnar subscribers with predicates only receive matching events",
+      "Subscriptions to a columnar stream may declare a predicate (ranges over integer columns). The stream evaluates it for the whole block before delivery, and the listener only handles the selected rows." )
+{
+    cs225::ColumnarStream<MouseClickedEvent> clicks( 8u );
+    ClickSummer everything, left_half, top_left;
+
+    clicks.subscribe( everything );
+    clicks.subscribe( left_half, cs225::Predicate().where( 0, 0, 3 ) );
+    clicks.subscribe( top_left, cs225::Predicate().where( 0, 0, 3 ).where( 1, 0, 10 ) );
+
+    for( int i = 0; i < 8; ++i )
+        clicks.append( i, 10 * i );
+
+    ASSERT_THAT( everything.sum_x == 0 + 1 + 2 + 3 + 4 + 5 + 6 + 7 );
+    // x in [0, 3] is a single run of rows
+    ASSERT_THAT( left_half.sum_x == 0 + 1 + 2 + 3 );
+    ASSERT_THAT( left_half.block_sizes.size() == 1u );
+    // y in [0, 10] narrows it down to the first two
+    ASSERT_THAT( top_left.sum_x == 0 + 1 && top_left.sum_y == 0 + 10 );
+
+    // conditions only apply to columns of 32-bit integers
+    try
+    {
+        clicks.subscribe( everything, cs225::Predicate().where( 2, 0, 1 ) );
+        FAIL();
+    }
+    catch( const std::invalid_argument & ) {}
+}
+
+} // namespace Columnar
+} // namespace Tests
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include "bounded_queue.hh" // cs225::BoundedQueue, cs225::QueueLimit, cs225::OverflowPolicy
+#include "event_queue.hh"   // cs225::EventQueue
+
+#include <thread>       // std::thread
+
+/*********************************************************************
+ *                        Bounded queue tests                        *
+ *********************************************************************/
+
+namespace Tests { namespace BoundedQueue
+{
+
+// pops everything left in the queue
+std::vector<int> drain( cs225::BoundedQueue<int> & queue )
+{
+    std::vector<int> values;
+    int value;
+    while( queue.try_pop( value ) )
+        values.push_back( value );
+    return values;
+}
+
+// [ Test #27 ] -------------------------------------------------------
+TEST( "Full queues apply their overflow policy",
+      "A bounded queue never holds more elements than its capacity. When it is full, a new element is either discarded, replaces the oldest one, or (sampling) one in every few new elements replaces the oldest one. Drops are counted." )
+{
+    cs225::BoundedQueue<int> newest( cs225::QueueLimit( 2u, cs225::OverflowPolicy::drop_newest ) );
+    for( int i = 0; i < 5; ++i )
+        newest.push( i );
+    ASSERT_THAT( newest.get_counters().dropped == 3u );
+    ASSERT_THAT( newest.get_counters().high_watermark == 2u );
+    ASSERT_THAT( drain( newest ) == std::vector<int>({ 0, 1 }) );
+
+    cs225::BoundedQueue<int> oldest( cs225::QueueLimit( 2u, cs225::OverflowPolicy::drop_oldest ) );
+    for( int i = 0; i < 5; ++i )
+        oldest.push( i );
+    ASSERT_THAT( oldest.get_counters().dropped == 3u );
+    ASSERT_THAT( drain( oldest ) == std::vector<int>({ 3, 4 }) );
+
+    // the 4th overflowing element (5) replaces the oldest one
+    cs225::BoundedQueue<int> sampled( cs225::QueueLimit( 2u, cs225::OverflowPolicy::sample, 4u ) );
+    for( int i = 0; i < 6; ++i )
+        sampled.push( i );
+    ASSERT_THAT( sampled.get_counters().dropped == 4u );
+    ASSERT_THAT( drain( sampled ) == std::vector<int>({ 1, 5 }) );
+    ASSERT_THAT( sampled.get_counters().popped == 2u );
+
+    // a full blocking queue refuses what it can't wait for
+    cs225::BoundedQueue<int> blocking( cs225::QueueLimit( 1u ) );
+    int value = 1;
+    ASSERT_THAT( blocking.try_push( value ) == cs225::PushResult::accepted );
+    ASSERT_THAT( blocking.try_push( value ) == cs225::PushResult::would_block );
+}
+
+// classifies ints by parity
+struct Parity
+{
+    std::uint64_t operator()( int value ) const { return value % 2; }
+};
+
+// [ Test #28 ] -------------------------------------------------------
+TEST( "Classes of elements can have their own queue limits",
+      "Elements are grouped in classes (e.g. event types), and a class limit bounds how many elements of that class are queued, so that a flood of one kind can't push out the others." )
+{
+    cs225::BoundedQueue<int, Parity> queue( cs225::QueueLimit( 10u, cs225::OverflowPolicy::drop_newest ) );
+    queue.push( 1 );
+    queue.set_class_limit( 1u, cs225::QueueLimit( 2u, cs225::OverflowPolicy::drop_oldest ) );
+
+    for( int i = 2; i < 10; ++i )
+        queue.push( i );
+
+    // only the two newest odd values are kept, all the even ones are
+    ASSERT_THAT( queue.get_class_counters( 1u ).dropped == 3u );
+    ASSERT_THAT( queue.get_class_counters( 0u ).dropped == 0u );
+    ASSERT_THAT( queue.get_counters().dropped == 3u );
+
+    std::vector<int> values;
+    int value;
+    while( queue.try_pop( value ) )
+        values.push_back( value );
+    ASSERT_THAT( values == std::vector<int>({ 2, 4, 6, 7, 8, 9 }) );
+}
+
+// [ Test #29 ] -------------------------------------------------------
+TEST( "Blocking queues make producers wait for room",
+      "With the blocking policy, a producer pushing to a full queue waits until a consumer pops an element. Closing the queue releases waiting producers and consumers." )
+{
+    cs225::BoundedQueue<int> queue( cs225::QueueLimit( 2u ) );
+    std::thread producer( [&queue]()
+    {
+        for( int i = 0; i < 100; ++i )
+            queue.push( i );
+        queue.close();
+    } );
+
+    std::vector<int> values;
+    int value;
+    while( queue.pop( value ) )
+        values.push_back( value );
+    producer.join();
+
+    ASSERT_THAT( values.size() == 100u );
+    for( int i = 0; i < 100; ++i )
+        ASSERT_THAT( values[i] == i );
+    ASSERT_THAT( queue.get_counters().high_watermark <= 2u );
+    ASSERT_THAT( queue.get_counters().dropped == 0u );
+
+    // nothing gets in once closed
+    ASSERT_THAT( !queue.push( 1 ) );
+}
+
+struct TickEvent : public cs225::Event {};
+struct BurstEvent : public cs225::Event {};
+struct LateTickEvent : public TickEvent {};
+
+// on every burst, triggers a number of ticks from inside the handler
+struct BurstListener : public cs225::Listener
+{
+    BurstListener()
+        : ticks(0) {}
+
+    virtual void handle_event( const cs225::Event & event )
+    {
+        if( cs225::type_of(event) == cs225::type_of<BurstEvent>() )
+        {
+            for( int i = 0; i < 10; ++i )
+                cs225::trigger_event( TickEvent() );
+        }
+        else
+            ticks++;
+    }
+
+    int ticks;
+};
+
+// [ Test #30 ] -------------------------------------------------------
+TEST( "Event queues are bounded per event type",
+      "Both the dispatcher's queue of re-entrant events and the queue that hands events over from other threads take limits per event type, and count what they drop." )
+{
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+    BurstListener listener;
+    event_dispatcher.subscribe( listener, cs225::type_of<BurstEvent>() );
+    event_dispatcher.subscribe( listener, cs225::type_of<TickEvent>() );
+
+    event_dispatcher.set_reentrancy_policy( cs225::ReentrancyPolicy::queued );
+    event_dispatcher.set_queue_limit( cs225::type_of<TickEvent>(), cs225::QueueLimit( 4u, cs225::OverflowPolicy::drop_newest ) );
+    cs225::trigger_event( BurstEvent() );
+    ASSERT_THAT( listener.ticks == 4 );
+    ASSERT_THAT( event_dispatcher.get_queue_counters( cs225::type_of<TickEvent>() ).dropped == 6u );
+
+    // a blocking limit can't wait during a dispatch: the overflow is dispatched right away
+    listener.ticks = 0;
+    event_dispatcher.set_queue_limit( cs225::type_of<TickEvent>(), cs225::QueueLimit( 4u ) );
+    cs225::trigger_event( BurstEvent() );
+    ASSERT_THAT( listener.ticks == 10 );
+
+    event_dispatcher.set_queue_limit( cs225::type_of<TickEvent>(), cs225::QueueLimit() );
+    event_dispatcher.set_reentrancy_policy( cs225::ReentrancyPolicy::immediate );
+
+    // events posted from another thread are triggered when pumped
+    listener.ticks = 0;
+    cs225::EventQueue queue;
+    queue.set_type_limit( cs225::type_of<TickEvent>(), cs225::QueueLimit( 3u, cs225::OverflowPolicy::drop_oldest ) );
+    std::thread producer( [&queue]()
+    {
+        for( int i = 0; i < 5; ++i )
+            queue.post( TickEvent() );
+    } );
+    producer.join();
+
+    ASSERT_THAT( queue.pump() == 3u );
+    ASSERT_THAT( listener.ticks == 3 );
+    ASSERT_THAT( queue.get_counters( cs225::type_of<TickEvent>() ).dropped == 2u );
+
+    // an event posted through a base class reference would be sliced: it is refused
+    LateTickEvent late;
+    const TickEvent & base = late;
+    ASSERT_THAT( !queue.post( base ) );
+    ASSERT_THAT( queue.size() == 0u && queue.pump() == 0u );
+
+    event_dispatcher.clear();
+}
+
+} // namespace BoundedQueue
+} // namespace Tests
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include "event_dispatcher.hh" // cs225::trigger, cs225::trigger_lazy, cs225::has_subscribers
+
+/*********************************************************************
+ *                    Lazy event construction tests                  *
+ *********************************************************************/
+
+namespace Tests { namespace LazyTrigger
+{
+
+// counts how it gets constructed
+struct SnapshotEvent : public cs225::Event
+{
+    SnapshotEvent( int v )
+        : value(v) { constructed++; }
+    SnapshotEvent( const SnapshotEvent & other )
+        : cs225::Event(other), value(other.value) { copied++; }
+
+    int value;
+
+    static int constructed;
+    static int copied;
+};
+int SnapshotEvent::constructed = 0;
+int SnapshotEvent::copied = 0;
+
+struct SnapshotListener : public cs225::Listener
+{
+    virtual void handle_event( const cs225::Event & event )
+    {
+        values.push_back( static_cast<const SnapshotEvent &>( event ).value );
+        // triggered from inside the dispatch: queued depending on the policy
+        if( values.size() == 1u && lazy )
+            cs225::trigger_lazy<SnapshotEvent>( []() { return SnapshotEvent( 2 ); } );
+        else if( values.size() == 1u )
+            cs225::trigger<SnapshotEvent>( 2 );
+    }
+
+    SnapshotListener()
+        : lazy(false) {}
+    std::vector<int> values;
+    bool lazy;
+};
+
+// [ Test #31 ] -------------------------------------------------------
+TEST( "Events are only constructed when someone listens",
+      "trigger<E>( args... ) and trigger_lazy<E>( factory ) check for subscribers first, and only then construct the event (once, without copies, even when it is queued). has_subscribers<E>() tells whether anyone listens to a type." )
+{
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+    SnapshotEvent::constructed = SnapshotEvent::copied = 0;
+
+    bool factory_called = false;
+    ASSERT_THAT( !cs225::has_subscribers<SnapshotEvent>() );
+    cs225::trigger<SnapshotEvent>( 1 );
+    cs225::trigger_lazy<SnapshotEvent>( [&factory_called]() { factory_called = true; return SnapshotEvent( 1 ); } );
+    ASSERT_THAT( SnapshotEvent::constructed == 0 && !factory_called );
+
+    SnapshotListener listener;
+    cs225::SubscriptionToken token = event_dispatcher.subscribe( listener, cs225::type_of<SnapshotEvent>() );
+    ASSERT_THAT( cs225::has_subscribers<SnapshotEvent>() );
+
+    cs225::trigger<SnapshotEvent>( 1 );
+    ASSERT_THAT( listener.values == std::vector<int>({ 1, 2 }) );
+    ASSERT_THAT( SnapshotEvent::constructed == 2 && SnapshotEvent::copied == 0 );
+
+    // the re-entrant event is constructed right in the queue
+    listener.values.clear();
+    event_dispatcher.set_reentrancy_policy( cs225::ReentrancyPolicy::queued );
+    cs225::trigger_lazy<SnapshotEvent>( [&factory_called]() { factory_called = true; return SnapshotEvent( 1 ); } );
+    ASSERT_THAT( factory_called );
+    ASSERT_THAT( listener.values == std::vector<int>({ 1, 2 }) );
+    ASSERT_THAT( SnapshotEvent::copied == 0 );
+    // and so is the result of a factory
+    listener.values.clear();
+    listener.lazy = true;
+    cs225::trigger<SnapshotEvent>( 1 );
+    ASSERT_THAT( listener.values == std::vector<int>({ 1, 2 }) );
+    ASSERT_THAT( SnapshotEvent::copied == 0 );
+    event_dispatcher.set_reentrancy_policy( cs225::ReentrancyPolicy::immediate );
+
+    event_dispatcher.unsubscribe( token );
+    ASSERT_THAT( !cs225::has_subscribers<SnapshotEvent>() );
+}
+
+} // namespace LazyTrigger
+} // namespace Tests
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include "shared_event.hh" // cs225::SharedEvent, cs225::EventPool, cs225::make_shared_event
+
+#include <atomic>       // std::atomic
+
+/*********************************************************************
+ *                        Shared event tests                         *
+ *********************************************************************/
+
+namespace Tests { namespace SharedEvent
+{
+
+// counts its copies and destructions
+struct FrameEvent : public cs225::Event
+{
+    FrameEvent( int n )
+        : number(n) {}
+    FrameEvent( const FrameEvent & other )
+        : cs225::Event(other), number(other.number) { copied++; }
+    ~FrameEvent() { destroyed++; }
+
+    int number;
+
+    static std::atomic<int> copied;
+    static std::atomic<int> destroyed;
+};
+std::atomic<int> FrameEvent::copied( 0 );
+std::atomic<int> FrameEvent::destroyed( 0 );
+
+// [ Test #32 ] -------------------------------------------------------
+TEST( "Shared events are handed out without copies and freed by the last owner",
+      "A shared event is an immutable, reference counted event allocated from a per-type pool. Copies of the handle share the event, so fanning it out to consumers on other threads copies nothing, and the last handle to go away destroys the event and returns its memory to the pool." )
+{
+    cs225::EventPool<FrameEvent> & pool = cs225::EventPool<FrameEvent>::get_instance();
+    FrameEvent::copied = FrameEvent::destroyed = 0;
+
+    {
+        cs225::SharedEvent frame = cs225::make_shared_event<FrameEvent>( 7 );
+        ASSERT_THAT( frame.get_type() == cs225::type_of<FrameEvent>() );
+        ASSERT_THAT( frame.as<FrameEvent>().number == 7 );
+
+        cs225::SharedEvent other = frame;
+        ASSERT_THAT( frame.use_count() == 2u && other.get() == frame.get() );
+        ASSERT_THAT( pool.get_in_use() == 1u );
+    }
+    ASSERT_THAT( FrameEvent::destroyed == 1 );
+    ASSERT_THAT( pool.get_in_use() == 0u );
+
+    // fan out to consumers on other threads
+    const std::size_t capacity = pool.get_capacity();
+    std::vector<cs225::BoundedQueue<cs225::SharedEvent>> queues( 3u );
+    std::atomic<int> sum( 0 );
+    std::vector<std::thread> consumers;
+    for( cs225::BoundedQueue<cs225::SharedEvent> & queue : queues )
+        consumers.push_back( std::thread( [&queue, &sum]()
+        {
+            cs225::SharedEvent frame;
+            while( queue.pop( frame ) )
+                sum += frame.as<FrameEvent>().number;
+        } ) );
+
+    for( int i = 0; i < 100; ++i )
+    {
+        cs225::SharedEvent frame = cs225::make_shared_event<FrameEvent>( i );
+        for( cs225::BoundedQueue<cs225::SharedEvent> & queue : queues )
+            queue.push( frame );
+    }
+    for( cs225::BoundedQueue<cs225::SharedEvent> & queue : queues )
+        queue.close();
+    for( std::thread & consumer : consumers )
+        consumer.join();
+
+    ASSERT_THAT( sum == 3 * ( 99 * 100 / 2 ) );
+    ASSERT_THAT( FrameEvent::copied == 0 );
+    ASSERT_THAT( FrameEvent::destroyed == 101 );
+    ASSERT_THAT( pool.get_in_use() == 0u );
+    // the memory is reused: at most 100 events are alive at a time
+    ASSERT_THAT( pool.get_capacity() >= capacity && pool.get_capacity() <= 128u );
+
+    // an event queue takes shared events as they are
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+    struct FrameListener : public cs225::Listener
+    {
+        FrameListener() : last(0) {}
+        virtual void handle_event( const cs225::Event & event ) { last = static_cast<const FrameEvent &>( event ).number; }
+        int last;
+    } listener;
+    event_dispatcher.subscribe( listener, cs225::type_of<FrameEvent>() );
+
+    cs225::EventQueue queue;
+    queue.post( cs225::make_shared_event<FrameEvent>( 42 ) );
+    queue.pump();
+    ASSERT_THAT( listener.last == 42 && FrameEvent::copied == 0 );
+
+    event_dispatcher.clear();
+}
+
+} // namespace SharedEvent
+} // namespace Tests
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include "subscriber_list.hh" // cs225::SubscriberList
+#include "event_dispatcher.hh" // cs225::EventDispatcher::get_memory_usage
+
+/*********************************************************************
+ *                  Compact subscription storage tests               *
+ *********************************************************************/
+
+namespace Tests { namespace CompactStorage
+{
+
+struct RareEvent : public cs225::Event {};
+struct FrequentEvent : public cs225::Event {};
+
+struct CountingListener : public cs225::Listener
+{
+    CountingListener()
+        : count(0) {}
+    virtual void handle_event( const cs225::Event & ) { count++; }
+    int count;
+};
+
+// [ Test #33 ] -------------------------------------------------------
+TEST( "Subscriber lists are compact and keep slot map semantics",
+      "Subscriber lists store 32-bit listener handles, keep a couple of subscriptions inline without allocating, and grow into a single packed allocation. Keys go stale on erasure just like in a slot map." )
+{
+    cs225::SubscriberList list;
+    cs225::SlotKey a = list.insert( 10u );
+    cs225::SlotKey b = list.insert( 20u );
+    ASSERT_THAT( list.heap_bytes() == 0u );
+
+    std::vector<cs225::SlotKey> keys;
+    for( cs225::ListenerHandle handle = 100u; handle < 200u; ++handle )
+        keys.push_back( list.insert( handle ) );
+    ASSERT_THAT( list.size() == 102u );
+    // 16 bytes per subscription, plus the growth slack
+    ASSERT_THAT( list.heap_bytes() >= 102u * 16u && list.heap_bytes() <= 102u * 16u * 3u / 2u );
+
+    ASSERT_THAT( list.erase( a ) && !list.erase( a ) && !list.contains( a ) );
+    ASSERT_THAT( *list.find( b ) == 20u );
+    for( std::size_t i = 0; i < keys.size(); i += 2 )
+        list.erase( keys[i] );
+    for( std::size_t i = 1; i < keys.size(); i += 2 )
+        ASSERT_THAT( *list.find( keys[i] ) == 100u + i );
+    ASSERT_THAT( list.size() == 51u );
+
+    // recycled slots get new generations
+    cs225::SlotKey c = list.insert( 7u );
+    ASSERT_THAT( c.index == keys[98].index && c != keys[98] );
+
+    // the slack goes, the values stay
+    list.shrink_to_fit();
+    ASSERT_THAT( list.heap_bytes() == 102u * 16u );
+    ASSERT_THAT( *list.find( b ) == 20u && *list.find( c ) == 7u && *list.find( keys[99] ) == 199u );
+
+    list.clear();
+    ASSERT_THAT( list.empty() && !list.contains( b ) && !list.contains( c ) );
+}
+
+// [ Test #34 ] -------------------------------------------------------
+TEST( "The event dispatcher reports the memory taken by subscriptions",
+      "The memory used by the subscriptions can be queried per event type and for the whole dispatcher, which shares one listener table among all the types." )
+{
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+    event_dispatcher.clear();
+
+    std::vector<CountingListener> listeners( 1000u );
+    event_dispatcher.subscribe( listeners[0], cs225::type_of<RareEvent>() );
+    for( CountingListener & listener : listeners )
+        event_dispatcher.subscribe( listener, cs225::type_of<FrequentEvent>() );
+
+    cs225::MemoryUsage rare = event_dispatcher.get_memory_usage( cs225::type_of<RareEvent>() );
+    cs225::MemoryUsage frequent = event_dispatcher.get_memory_usage( cs225::type_of<FrequentEvent>() );
+    cs225::MemoryUsage total = event_dispatcher.get_memory_usage();
+    ASSERT_THAT( rare.subscriptions == 1u && frequent.subscriptions == 1000u );
+    ASSERT_THAT( rare.bytes < 100u );
+    ASSERT_THAT( frequent.bytes >= 1000u * 16u && frequent.bytes < 1000u * 32u );
+    ASSERT_THAT( total.subscriptions == 1001u && total.bytes > rare.bytes + frequent.bytes );
+
+    event_dispatcher.shrink_to_fit();
+    // a list of 1000 takes exactly 16 bytes per subscription more than the inline list of 1
+    ASSERT_THAT( event_dispatcher.get_memory_usage( cs225::type_of<FrequentEvent>() ).bytes == rare.bytes + 1000u * 16u );
+
+    cs225::trigger_event( FrequentEvent() );
+    cs225::trigger_event( RareEvent() );
+    ASSERT_THAT( listeners[0].count == 2 && listeners[999].count == 1 );
+
+    // listeners are looked up by handle when unsubscribing by listener
+    event_dispatcher.unsubscribe( listeners[0], cs225::type_of<FrequentEvent>() );
+    cs225::trigger_event( FrequentEvent() );
+    cs225::trigger_event( RareEvent() );
+    ASSERT_THAT( listeners[0].count == 3 && listeners[999].count == 2 );
+
+    event_dispatcher.clear();
+    ASSERT_THAT( event_dispatcher.get_memory_usage().subscriptions == 0u );
+}
+
+} // namespace CompactStorage
+} // namespace Tests
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include "tick_scheduler.hh" // cs225::TickScheduler, cs225::TickSystem, cs225::TickContext
+
+/*********************************************************************
+ *                       Tick scheduler tests                        *
+ *********************************************************************/
+
+namespace Tests { namespace TickScheduler
+{
+
+struct NumberEvent : public cs225::Event
+{
+    NumberEvent( int v ) : value(v) {}
+    int value;
+};
+struct DoubledEvent : public cs225::Event
+{
+    DoubledEvent( int v ) : value(v) {}
+    int value;
+};
+struct FeedbackEvent : public cs225::Event
+{
+    FeedbackEvent( int v ) : value(v) {}
+    int value;
+};
+
+// emits two numbers per tick
+struct Counter : public cs225::TickSystem
+{
+    virtual void update( cs225::TickContext & context )
+    {
+        int tick = static_cast<int>( context.get_tick() );
+        context.emit<NumberEvent>( 10 * tick );
+        context.emit<NumberEvent>( 10 * tick + 1 );
+    }
+};
+
+struct Doubler : public cs225::TickSystem
+{
+    virtual void update( cs225::TickContext & context )
+    {
+        context.for_each<NumberEvent>( [&context]( const NumberEvent & event ) { context.emit<DoubledEvent>( 2 * event.value ); } );
+    }
+};
+
+// logs what it sees in every tick
+struct Recorder : public cs225::TickSystem
+{
+    virtual void update( cs225::TickContext & context )
+    {
+        std::ostringstream oss;
+        oss << context.get_tick() << ":";
+        context.for_each<NumberEvent>( [&oss]( const NumberEvent & event ) { oss << " n" << event.value; } );
+        context.for_each<DoubledEvent>( [&oss]( const DoubledEvent & event ) { oss << " d" << event.value; } );
+        context.for_each<FeedbackEvent>( [&oss]( const FeedbackEvent & event ) { oss << " f" << event.value; } );
+        log.push_back( oss.str() );
+    }
+    std::vector<std::string> log;
+};
+
+struct Feedback : public cs225::TickSystem
+{
+    virtual void update( cs225::TickContext & context )
+    {
+        context.emit<FeedbackEvent>( static_cast<int>( context.count( cs225::type_of<DoubledEvent>() ) ) );
+    }
+};
+
+// [ Test #35 ] -------------------------------------------------------
+TEST( "Tick systems see events according to their registration order",
+      "Systems declare the event types they consume and produce. A consumer registered after a producer runs after it and sees its events in the same tick; events from producers registered later (and posted events) are seen in the next tick." )
+{
+    cs225::TickScheduler scheduler( 1u );
+    Counter counter;
+    Doubler doubler;
+    Recorder recorder;
+    Feedback feedback;
+
+    scheduler.add_system( counter, {}, { cs225::type_of<NumberEvent>() } );
+    scheduler.add_system( doubler, { cs225::type_of<NumberEvent>() }, { cs225::type_of<DoubledEvent>() } );
+    scheduler.add_system( recorder, { cs225::type_of<NumberEvent>(), cs225::type_of<DoubledEvent>(), cs225::type_of<FeedbackEvent>() }, {} );
+    scheduler.add_system( feedback, { cs225::type_of<DoubledEvent>() }, { cs225::type_of<FeedbackEvent>() } );
+
+    scheduler.tick();
+    scheduler.post( NumberEvent( 7 ) );
+    scheduler.tick();
+    scheduler.tick();
+
+    ASSERT_THAT( recorder.log.size() == 3u );
+    ASSERT_THAT( recorder.log[0] == "0: n0 n1 d0 d2" );
+    // the posted number comes first, the feedback of the previous tick is seen now
+    ASSERT_THAT( recorder.log[1] == "1: n7 n10 n11 d14 d20 d22 f2" );
+    ASSERT_THAT( recorder.log[2] == "2: n20 n21 d40 d42 f3" );
+    ASSERT_THAT( scheduler.get_tick_count() == 3u );
+}
+
+// a layer of the determinism workload: mixes what it receives into what it emits
+struct Mixer : public cs225::TickSystem
+{
+    Mixer( int s ) : seed(s) {}
+    virtual void update( cs225::TickContext & context )
+    {
+        std::uint64_t state = static_cast<std::uint64_t>( seed );
+        context.for_each<NumberEvent>( [&state]( const NumberEvent & event ) { state = state * 31 + static_cast<std::uint64_t>( event.value ); } );
+        context.emit<NumberEvent>( static_cast<int>( state % 1000 ) );
+        history.push_back( state );
+    }
+    int seed;
+    std::vector<std::uint64_t> history;
+};
+
+std::vector<std::uint64_t> run_mixers( std::size_t threads, const cs225::ThreadPlacement & placement = cs225::ThreadPlacement() )
+{
+    cs225::TickScheduler scheduler( threads, placement );
+    std::vector<Mixer> mixers;
+    for( int i = 0; i < 16; ++i )
+        mixers.push_back( Mixer( i ) );
+    for( Mixer & mixer : mixers )
+        scheduler.add_system( mixer, { cs225::type_of<NumberEvent>() }, { cs225::type_of<NumberEvent>() } );
+    for( int tick = 0; tick < 20; ++tick )
+        scheduler.tick();
+
+    std::vector<std::uint64_t> histories;
+    for( const Mixer & mixer : mixers )
+        histories.insert( histories.end(), mixer.history.begin(), mixer.history.end() );
+    return histories;
+}
+
+struct Failing : public cs225::TickSystem
+{
+    virtual void update( cs225::TickContext & context )
+    {
+        context.emit<DoubledEvent>( 1 ); // not declared
+    }
+};
+
+struct NumberTally : public cs225::TickSystem
+{
+    NumberTally() : seen(0) {}
+    virtual void update( cs225::TickContext & context )
+    {
+        context.for_each<NumberEvent>( [this]( const NumberEvent & ) { seen++; } );
+    }
+    int seen;
+};
+
+// [ Test #36 ] -------------------------------------------------------
+TEST( "Tick results don't depend on the number of threads",
+      "Independent systems run in parallel, and what each system sees is the same whatever the number of threads. Using undeclared event types is an error, which is reported once the tick completes." )
+{
+    std::vector<std::uint64_t> sequential = run_mixers( 1u );
+    ASSERT_THAT( run_mixers( 2u ) == sequential );
+    ASSERT_THAT( run_mixers( 4u ) == sequential );
+
+    cs225::TickScheduler scheduler( 2u );
+    Counter counter;
+    Failing failing;
+    NumberTally tally;
+    scheduler.add_system( counter, {}, { cs225::type_of<NumberEvent>() } );
+    scheduler.add_system( failing, {}, {} );
+    scheduler.add_system( tally, { cs225::type_of<NumberEvent>() }, {} );
+    try
+    {
+        scheduler.tick();
+        FAIL();
+    }
+    catch( const cs225::UndeclaredEventType & ) {}
+    // the other systems ran anyway
+    ASSERT_THAT( tally.seen == 2 );
+}
+
+} // namespace TickScheduler
+} // namespace Tests
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include "watchdog.hh" // cs225::LatencyBudget, cs225::SlowHandlerLog
+#include <chrono>       // std::chrono::milliseconds
+#include <cstring>      // std::strstr
+
+/*********************************************************************
+ *                      Slow-handler watchdog tests                  *
+ *********************************************************************/
+
+namespace Tests { namespace Watchdog
+{
+
+struct WatchedEvent : public cs225::Event {};
+
+struct QuickListener : public cs225::Listener
+{
+    QuickListener()
+        : count(0) {}
+    virtual void handle_event( const cs225::Event & ) { count++; }
+    int count;
+};
+
+// takes longer than the budgets of the tests, and remembers where it ran
+struct SluggishListener : public cs225::Listener
+{
+    SluggishListener()
+        : count(0) {}
+    virtual void handle_event( const cs225::Event & )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 3 ) );
+        thread = std::this_thread::get_id();
+        count++;
+    }
+    int count;
+    std::thread::id thread;
+};
+
+// [ Test #37 ] -------------------------------------------------------
+TEST( "Handlers over their latency budget are recorded",
+      "With a latency budget set, handlers (and whole dispatches) that take longer than their budget are recorded with the listener type, the event type and the duration in a ring buffer that keeps the latest records." )
+{
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+    event_dispatcher.clear();
+    event_dispatcher.get_slow_handlers().set_capacity( 2u );
+
+    QuickListener quick;
+    SluggishListener sluggish;
+    event_dispatcher.subscribe( quick, cs225::type_of<WatchedEvent>() );
+    event_dispatcher.subscribe( sluggish, cs225::type_of<WatchedEvent>() );
+
+    // no budget, nothing is timed
+    cs225::trigger_event( WatchedEvent() );
+    ASSERT_THAT( event_dispatcher.get_slow_handlers().get_total() == 0u );
+
+    event_dispatcher.set_latency_budget( cs225::LatencyBudget( std::chrono::milliseconds( 1 ), std::chrono::milliseconds( 2 ) ) );
+    cs225::trigger_event( WatchedEvent() );
+    std::vector<cs225::SlowHandlerRecord> records = event_dispatcher.get_slow_handlers().get_records();
+    ASSERT_THAT( records.size() == 2u );
+    ASSERT_THAT( std::strstr( records[0].listener_type, "SluggishListener" ) != nullptr );
+    ASSERT_THAT( std::strstr( records[0].event_type, "WatchedEvent" ) != nullptr );
+    ASSERT_THAT( records[0].duration >= std::chrono::milliseconds( 3 ) );
+    // the dispatch as a whole
+    ASSERT_THAT( records[1].listener_type == nullptr );
+    ASSERT_THAT( records[1].duration >= records[0].duration );
+
+    // only the latest records are kept
+    event_dispatcher.set_latency_budget( cs225::LatencyBudget( std::chrono::milliseconds( 1 ) ) );
+    cs225::trigger_event( WatchedEvent() );
+    cs225::trigger_event( WatchedEvent() );
+    records = event_dispatcher.get_slow_handlers().get_records();
+    ASSERT_THAT( event_dispatcher.get_slow_handlers().get_total() == 4u );
+    ASSERT_THAT( records.size() == 2u && records[0].listener_type != nullptr && records[1].listener_type != nullptr );
+    ASSERT_THAT( quick.count == 4 && sluggish.count == 4 );
+    // never demoted by default
+    ASSERT_THAT( !event_dispatcher.is_demoted( sluggish ) );
+
+    event_dispatcher.set_latency_budget( cs225::LatencyBudget() );
+    event_dispatcher.get_slow_handlers().set_capacity( 64u );
+    event_dispatcher.clear();
+}
+
+// [ Test #38 ] -------------------------------------------------------
+TEST( "Repeatedly slow listeners are demoted to a worker thread",
+      "A listener over its budget too many times gets its events asynchronously on a worker thread, so it doesn't hold up the other listeners. Events that can't be copied are still delivered synchronously." )
+{
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+    event_dispatcher.clear();
+    event_dispatcher.set_latency_budget( cs225::LatencyBudget( std::chrono::milliseconds( 1 ), std::chrono::nanoseconds::zero(), 2u ) );
+
+    QuickListener quick;
+    SluggishListener sluggish;
+    event_dispatcher.subscribe( sluggish, cs225::type_of<WatchedEvent>() );
+    event_dispatcher.subscribe( quick, cs225::type_of<WatchedEvent>() );
+
+    cs225::trigger_event( WatchedEvent() );
+    ASSERT_THAT( !event_dispatcher.is_demoted( sluggish ) );
+    cs225::trigger_event( WatchedEvent() );
+    ASSERT_THAT( event_dispatcher.is_demoted( sluggish ) );
+    ASSERT_THAT( sluggish.thread == std::this_thread::get_id() );
+
+    std::uint64_t delivered = event_dispatcher.get_demoted_worker().get_delivered();
+    cs225::trigger_event( WatchedEvent() );
+    cs225::trigger<WatchedEvent>();
+    ASSERT_THAT( quick.count == 4 );
+    event_dispatcher.flush_demoted();
+    ASSERT_THAT( sluggish.count == 4 && sluggish.thread != std::this_thread::get_id() );
+    ASSERT_THAT( event_dispatcher.get_demoted_worker().get_delivered() == delivered + 2u );
+
+    // a base class reference can't be copied without slicing
+    WatchedEvent event;
+    const cs225::Event & base = event;
+    cs225::trigger_event( base );
+    ASSERT_THAT( sluggish.count == 5 && sluggish.thread == std::this_thread::get_id() );
+
+    // the events waiting for a demoted listener are bounded, the overflow is counted
+    const std::uint64_t dropped = event_dispatcher.get_demoted_dropped();
+    event_dispatcher.set_demoted_queue_limit( cs225::QueueLimit( 1u, cs225::OverflowPolicy::drop_newest ) );
+    for( int i = 0; i < 5; ++i )
+        cs225::trigger_event( WatchedEvent() );
+    event_dispatcher.flush_demoted();
+    const std::uint64_t overflow = event_dispatcher.get_demoted_dropped() - dropped;
+    ASSERT_THAT( overflow >= 2u && overflow <= 4u );
+    ASSERT_THAT( static_cast<std::uint64_t>( sluggish.count ) + overflow == 10u );
+    event_dispatcher.set_demoted_queue_limit( cs225::QueueLimit( 1024u, cs225::OverflowPolicy::drop_oldest ) );
+
+    // unsubscribing waits for the pending deliveries
+    const int count = sluggish.count;
+    cs225::trigger_event( WatchedEvent() );
+    event_dispatcher.unsubscribe( sluggish, cs225::type_of<WatchedEvent>() );
+    ASSERT_THAT( sluggish.count == count + 1 );
+
+    event_dispatcher.set_latency_budget( cs225::LatencyBudget() );
+    event_dispatcher.get_slow_handlers().clear();
+    event_dispatcher.clear();
+}
+
+} // namespace Watchdog
+} // namespace Tests
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include "topic_channels.hh" // cs225::TopicChannels, cs225::TopicEvent
+
+/*********************************************************************
+ *                         Topic channel tests                       *
+ *********************************************************************/
+
+namespace Tests { namespace TopicChannels
+{
+
+// logs the topics and payloads it receives
+struct TopicRecorder : public cs225::Listener
+{
+    virtual void handle_event( const cs225::Event & event )
+    {
+        const cs225::TopicEvent & published = static_cast<const cs225::TopicEvent &>( event );
+        log.push_back( cs225::TopicChannels::get_instance().get_name( published.get_topic() ) + "=" + published.get_payload() );
+    }
+    std::vector<std::string> log;
+};
+
+// [ Test #39 ] -------------------------------------------------------
+TEST( "Topic names are interned into dense ids",
+      "Hierarchical topic names are interned once: the same name always gets the same id, and parents are interned along with their children. Malformed names are rejected." )
+{
+    cs225::TopicChannels & channels = cs225::TopicChannels::get_instance();
+    const std::size_t topic_count = channels.get_topic_count();
+
+    cs225::TopicId temperature = channels.intern( "tests/kitchen/temperature" );
+    cs225::TopicId humidity = channels.intern( "tests/kitchen/humidity" );
+    ASSERT_THAT( temperature != 0u && humidity != 0u && temperature != humidity );
+    ASSERT_THAT( channels.intern( "tests/kitchen/temperature" ) == temperature );
+    ASSERT_THAT( channels.find( "tests/kitchen/temperature" ) == temperature );
+    ASSERT_THAT( channels.get_name( temperature ) == "tests/kitchen/temperature" );
+
+    cs225::TopicId kitchen = channels.get_parent( temperature );
+    ASSERT_THAT( kitchen == channels.get_parent( humidity ) && channels.get_name( kitchen ) == "tests/kitchen" );
+    ASSERT_THAT( channels.get_topic_count() == topic_count + 4u );
+
+    ASSERT_THAT( channels.find( "tests/garage" ) == 0u );
+    ASSERT_THAT( channels.find( "tests/kitchen/temperature/max" ) == 0u );
+
+    const char * malformed[] = { "", "tests//kitchen", "tests/kitchen/", "tests/*", "tests/kit*chen" };
+    for( const char * name : malformed )
+    {
+        try
+        {
+            channels.intern( name );
+            FAIL();
+        }
+        catch( const cs225::InvalidTopic & ) {}
+    }
+    try
+    {
+        TopicRecorder recorder;
+        channels.subscribe( recorder, "tests/#/temperature" );
+        FAIL();
+    }
+    catch( const cs225::InvalidTopic & ) {}
+}
+
+// [ Test #40 ] -------------------------------------------------------
+TEST( "Topic events are routed to exact and wildcard subscribers",
+      "Subscribers get the events of their topic, or of every topic matching their pattern: '*' matches one level and a final '#' any number of levels. Exact subscribers are called first. Unsubscribing from inside a handler takes effect right away." )
+{
+    cs225::TopicChannels & channels = cs225::TopicChannels::get_instance();
+    channels.clear();
+
+    cs225::TopicId kitchen = channels.intern( "routing/kitchen/temperature" );
+    cs225::TopicId garage = channels.intern( "routing/garage/temperature" );
+    cs225::TopicId door = channels.intern( "routing/garage/door" );
+
+    TopicRecorder exact, one_level, any_level;
+    channels.subscribe( exact, kitchen );
+    channels.subscribe( one_level, "routing/*/temperature" );
+    cs225::TopicToken everything = channels.subscribe( any_level, "routing/#" );
+
+    cs225::publish( kitchen, "21" );
+    cs225::publish( garage, "12" );
+    channels.publish( cs225::TopicEvent( door, "open" ) );
+    ASSERT_THAT( exact.log == std::vector<std::string>( { "routing/kitchen/temperature=21" } ) );
+    ASSERT_THAT( one_level.log == std::vector<std::string>( { "routing/kitchen/temperature=21", "routing/garage/temperature=12" } ) );
+    ASSERT_THAT( any_level.log.size() == 3u && any_level.log[2] == "routing/garage/door=open" );
+
+    // a pattern can name topics that don't exist yet
+    cs225::TopicId window = channels.intern( "routing/garage/window" );
+    ASSERT_THAT( channels.has_subscribers( window ) );
+    ASSERT_THAT( channels.unsubscribe( everything ) && !channels.unsubscribe( everything ) );
+    ASSERT_THAT( !channels.has_subscribers( window ) );
+    cs225::publish( window, "closed" );
+    ASSERT_THAT( any_level.log.size() == 3u );
+
+    // a handler dropping the next subscriber: it isn't called anymore
+    struct Dropper : public cs225::Listener
+    {
+        virtual void handle_event( const cs225::Event & )
+        {
+            cs225::TopicChannels::get_instance().unsubscribe( victim );
+        }
+        cs225::TopicToken victim;
+    } dropper;
+    TopicRecorder dropped;
+    channels.subscribe( dropper, garage );
+    dropper.victim = channels.subscribe( dropped, garage );
+    cs225::publish( garage, "13" );
+    cs225::publish( garage, "14" );
+    ASSERT_THAT( dropped.log.empty() );
+    ASSERT_THAT( one_level.log.size() == 4u && one_level.log[3] == "routing/garage/temperature=14" );
+
+    channels.clear();
+    cs225::publish( kitchen, "22" );
+    ASSERT_THAT( exact.log.size() == 1u && !channels.has_subscribers( kitchen ) );
+}
+
+} // namespace TopicChannels
+} // namespace Tests
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include "subscription_set.hh" // cs225::SubscriptionSet
+
+/*********************************************************************
+ *                     Per-listener subscription tests               *
+ *********************************************************************/
+
+namespace Tests { namespace SubscriptionSets
+{
+
+struct FirstEvent : public cs225::Event {};
+struct SecondEvent : public cs225::Event {};
+struct ThirdEvent : public cs225::Event {};
+
+struct CountingListener : public cs225::Listener
+{
+    CountingListener()
+        : count(0) {}
+    virtual void handle_event( const cs225::Event & ) { count++; }
+    int count;
+};
+
+// [ Test #41 ] -------------------------------------------------------
+TEST( "Subscription sets keep a bitset of types with their keys",
+      "A subscription set tells in constant time whether a type slot is in it, finds the key of its subscription, and visits its subscriptions by increasing slot, inside and beyond the first 64 slots." )
+{
+    cs225::SubscriptionSet set;
+    ASSERT_THAT( set.empty() && !set.contains( 3u ) && !set.contains( 1000u ) );
+
+    set.insert( 70u, cs225::SlotKey{ 70u, 0u } );
+    set.insert( 3u, cs225::SlotKey{ 3u, 0u } );
+    set.insert( 200u, cs225::SlotKey{ 200u, 0u } );
+    set.insert( 1u, cs225::SlotKey{ 1u, 0u } );
+    ASSERT_THAT( set.size() == 4u );
+    ASSERT_THAT( set.contains( 1u ) && set.contains( 3u ) && set.contains( 70u ) && set.contains( 200u ) );
+    ASSERT_THAT( !set.contains( 2u ) && !set.contains( 71u ) && !set.contains( 199u ) );
+    ASSERT_THAT( set.find( 70u )->index == 70u && set.find( 200u )->index == 200u && set.find( 4u ) == nullptr );
+
+    std::vector<std::uint32_t> slots;
+    bool keys_match = true;
+    set.for_each( [&]( std::uint32_t slot, const cs225::SlotKey & key ) { slots.push_back( slot ); keys_match = keys_match && key.index == slot; } );
+    ASSERT_THAT( slots == std::vector<std::uint32_t>( { 1u, 3u, 70u, 200u } ) && keys_match );
+
+    ASSERT_THAT( set.erase( 3u ) && !set.erase( 3u ) );
+    ASSERT_THAT( set.find( 1u )->index == 1u && set.find( 70u )->index == 70u && set.size() == 3u );
+
+    set.clear();
+    ASSERT_THAT( set.empty() && !set.contains( 200u ) );
+}
+
+// [ Test #42 ] -------------------------------------------------------
+TEST( "Listeners can be unsubscribed from everything at once",
+      "The dispatcher knows which types each listener is subscribed to: subscribing twice to the same type is rejected, and unsubscribing a listener from everything only touches its own subscriptions, even from inside a handler." )
+{
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+    event_dispatcher.clear();
+
+    CountingListener leaving, staying;
+    event_dispatcher.subscribe( leaving, cs225::type_of<FirstEvent>() );
+    event_dispatcher.subscribe( leaving, cs225::type_of<SecondEvent>() );
+    event_dispatcher.subscribe( staying, cs225::type_of<FirstEvent>() );
+    event_dispatcher.subscribe( staying, cs225::type_of<ThirdEvent>() );
+    ASSERT_THAT( event_dispatcher.is_subscribed( leaving, cs225::type_of<SecondEvent>() ) );
+    ASSERT_THAT( !event_dispatcher.is_subscribed( leaving, cs225::type_of<ThirdEvent>() ) );
+
+    // a second subscription to the same type is rejected
+    cs225::SubscriptionToken duplicate = event_dispatcher.subscribe( leaving, cs225::type_of<FirstEvent>() );
+    ASSERT_THAT( !event_dispatcher.unsubscribe( duplicate ) );
+    cs225::trigger_event( FirstEvent() );
+    ASSERT_THAT( leaving.count == 1 && staying.count == 1 );
+
+    event_dispatcher.unsubscribe_all( leaving );
+    ASSERT_THAT( !event_dispatcher.is_subscribed( leaving, cs225::type_of<FirstEvent>() ) );
+    cs225::trigger_event( FirstEvent() );
+    cs225::trigger_event( SecondEvent() );
+    cs225::trigger_event( ThirdEvent() );
+    ASSERT_THAT( leaving.count == 1 && staying.count == 3 );
+    ASSERT_THAT( event_dispatcher.get_memory_usage().subscriptions == 2u );
+
+    // from inside a handler, the listener stops receiving the events in flight
+    struct Quitter : public cs225::Listener
+    {
+        Quitter() : next(nullptr) {}
+        virtual void handle_event( const cs225::Event & )
+        {
+            if( next )
+                cs225::EventDispatcher::get_instance().unsubscribe_all( *next );
+            next = nullptr;
+        }
+        cs225::Listener * next;
+    } quitter;
+    event_dispatcher.subscribe( quitter, cs225::type_of<FirstEvent>() );
+    event_dispatcher.subscribe( leaving, cs225::type_of<FirstEvent>() );
+    event_dispatcher.subscribe( leaving, cs225::type_of<ThirdEvent>() );
+    quitter.next = &leaving;
+    cs225::trigger_event( FirstEvent() );
+    ASSERT_THAT( leaving.count == 1 && staying.count == 4 );
+    ASSERT_THAT( event_dispatcher.get_memory_usage().subscriptions == 3u );
+
+    // a listener can subscribe again afterwards
+    event_dispatcher.subscribe( leaving, cs225::type_of<FirstEvent>() );
+    cs225::trigger_event( FirstEvent() );
+    ASSERT_THAT( leaving.count == 2 && staying.count == 5 );
+
+    event_dispatcher.clear();
+}
+
+} // namespace SubscriptionSets
+} // namespace Tests
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include "event_stream.hh" // cs225::stream, cs225::StreamSubscription
+
+/*********************************************************************
+ *                          Event stream tests                       *
+ *********************************************************************/
+
+namespace Tests { namespace EventStream
+{
+
+struct ReadingEvent : public cs225::Event
+{
+    ReadingEvent( int v ) : value(v) {}
+    int value;
+};
+
+struct AlarmEvent : public cs225::Event
+{
+    AlarmEvent( int l ) : level(l) {}
+    int level;
+};
+
+struct AlarmListener : public cs225::Listener
+{
+    virtual void handle_event( const cs225::Event & event )
+    {
+        levels.push_back( static_cast<const AlarmEvent &>( event ).level );
+    }
+    std::vector<int> levels;
+};
+
+// [ Test #43 ] -------------------------------------------------------
+TEST( "Event streams chain operators into a single subscription",
+      "Filter, map and window operators compose into one listener: the chain takes a single subscription, and it stays subscribed as long as its StreamSubscription lives (which the chain itself may end)." )
+{
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+    event_dispatcher.clear();
+
+    std::vector<int> sums;
+    {
+        cs225::StreamSubscription subscription = cs225::stream<ReadingEvent>()
+            .filter( []( const ReadingEvent & reading ) { return reading.value % 2 == 0; } )
+            .map( []( const ReadingEvent & reading ) { return reading.value * 10; } )
+            .filter( []( int value ) { return value != 40; } )
+            .window( 2u )
+            .map( []( const std::vector<int> & values ) { return values[0] + values[1]; } )
+            .subscribe( [&sums]( int sum ) { sums.push_back( sum ); } );
+        ASSERT_THAT( subscription.active() );
+        ASSERT_THAT( event_dispatcher.get_memory_usage().subscriptions == 1u );
+
+        for( int value = 1; value <= 10; ++value )
+            cs225::trigger_event( ReadingEvent( value ) );
+        // 20 60 80 100, in windows of two
+        ASSERT_THAT( sums == std::vector<int>( { 80, 180 } ) );
+    }
+    ASSERT_THAT( event_dispatcher.get_memory_usage().subscriptions == 0u );
+    cs225::trigger_event( ReadingEvent( 2 ) );
+    ASSERT_THAT( sums.size() == 2u );
+
+    // a stream is a description: it can be subscribed many times, each with its own state
+    auto pairs = cs225::stream<ReadingEvent>().window( 2u );
+    int first = 0, second = 0;
+    cs225::StreamSubscription a = pairs.subscribe( [&first]( const std::vector<ReadingEvent> & ) { first++; } );
+    cs225::trigger_event( ReadingEvent( 1 ) );
+    cs225::StreamSubscription b = pairs.subscribe( [&second]( const std::vector<ReadingEvent> & ) { second++; } );
+    cs225::trigger_event( ReadingEvent( 2 ) );
+    cs225::trigger_event( ReadingEvent( 3 ) );
+    ASSERT_THAT( first == 1 && second == 1 );
+
+    a.reset();
+    ASSERT_THAT( !a.active() && event_dispatcher.get_memory_usage().subscriptions == 1u );
+
+    // a chain can end its own subscription from its sink, its operators outlive the dispatch
+    cs225::StreamSubscription once;
+    int fired = 0;
+    once = pairs.subscribe( [&once, &fired]( const std::vector<ReadingEvent> & ) { fired++; once.reset(); } );
+    for( int value = 1; value <= 4; ++value )
+        cs225::trigger_event( ReadingEvent( value ) );
+    ASSERT_THAT( fired == 1 && !once.active() );
+    ASSERT_THAT( event_dispatcher.get_memory_usage().subscriptions == 1u );
+    event_dispatcher.clear();
+}
+
+// [ Test #44 ] -------------------------------------------------------
+TEST( "Event streams can throttle and trigger derived events",
+      "A throttled stream passes the first value and drops the ones that follow within the interval. A stream can end by triggering a derived event built from its values." )
+{
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+    event_dispatcher.clear();
+
+    AlarmListener alarms;
+    event_dispatcher.subscribe( alarms, cs225::type_of<AlarmEvent>() );
+    cs225::StreamSubscription subscription = cs225::stream<ReadingEvent>()
+        .filter( []( const ReadingEvent & reading ) { return reading.value > 100; } )
+        .throttle( std::chrono::hours( 1 ) )
+        .map( []( const ReadingEvent & reading ) { return reading.value / 100; } )
+        .trigger<AlarmEvent>();
+
+    cs225::trigger_event( ReadingEvent( 50 ) );
+    cs225::trigger_event( ReadingEvent( 250 ) );
+    cs225::trigger_event( ReadingEvent( 900 ) );
+    ASSERT_THAT( alarms.levels == std::vector<int>( { 2 } ) );
+
+    int passed = 0;
+    cs225::StreamSubscription unthrottled = cs225::stream<ReadingEvent>()
+        .throttle( std::chrono::nanoseconds::zero() )
+        .subscribe( [&passed]( const ReadingEvent & ) { passed++; } );
+    cs225::trigger_event( ReadingEvent( 1 ) );
+    cs225::trigger_event( ReadingEvent( 2 ) );
+    ASSERT_THAT( passed == 2 );
+
+    event_dispatcher.clear();
+}
+
+} // namespace EventStream
+} // namespace Tests
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include "perfect_hash.hh" // cs225::PerfectHashMap, cs225::TableFrozen
+
+/*********************************************************************
+ *                         Frozen table tests                        *
+ *********************************************************************/
+
+namespace Tests { namespace FrozenTables
+{
+
+struct TickEvent : public cs225::Event
+{};
+
+struct TockEvent : public cs225::Event
+{};
+
+// unsubscribes a token twice when it gets an event
+struct TokenDropper : public cs225::Listener
+{
+    TokenDropper() : first(false), second(false) {}
+    virtual void handle_event( const cs225::Event & )
+    {
+        cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+        first = event_dispatcher.unsubscribe( token );
+        second = event_dispatcher.unsubscribe( token );
+    }
+    cs225::SubscriptionToken token;
+    bool first, second;
+};
+
+struct CountingListener : public cs225::Listener
+{
+    CountingListener() : count(0) {}
+    virtual void handle_event( const cs225::Event & )
+    {
+        count++;
+    }
+    int count;
+};
+
+// [ Test #45 ] -------------------------------------------------------
+TEST( "Perfect hash maps and frozen event handlers",
+      "A perfect hash map finds every key it was built with and nothing else, and rejects duplicate keys. A frozen event handler dispatches through one, and refuses new handlers until thawed." )
+{
+    std::vector<std::pair<std::uint64_t, int>> entries;
+    for( int i = 0; i < 5000; ++i )
+        entries.push_back( std::make_pair( std::uint64_t( i ) * 0x9e3779b97f4a7c15ull, i ) );
+    cs225::PerfectHashMap<int> map;
+    map.build( entries );
+    ASSERT_THAT( map.size() == 5000u );
+
+    bool all_found = true;
+    for( const std::pair<std::uint64_t, int> & entry : entries )
+    {
+        const int * value = map.find( entry.first );
+        all_found = all_found && value && *value == entry.second;
+    }
+    ASSERT_THAT( all_found );
+    ASSERT_THAT( map.find( 12345u ) == nullptr );
+
+    entries.push_back( entries.front() );
+    bool rejected = false;
+    try { map.build( entries ); } catch( const std::invalid_argument & ) { rejected = true; }
+    ASSERT_THAT( rejected );
+    map.clear();
+    ASSERT_THAT( map.empty() && map.find( 0u ) == nullptr );
+
+    // a frozen event handler keeps dispatching, without its map
+    cs225::EventHandler app_event_handler;
+    Events::App my_app;
+    app_event_handler.register_handler( my_app, &Events::App::on_mouse_clicked );
+    app_event_handler.freeze();
+    ASSERT_THAT( app_event_handler.is_frozen() );
+    app_event_handler.handle( Events::MouseClickedEvent( 0, 0 ) );
+    ASSERT_THAT( my_app.is_focused );
+
+    bool refused = false;
+    try { app_event_handler.register_handler( my_app, &Events::App::on_button_clicked ); } catch( const cs225::TableFrozen & ) { refused = true; }
+    ASSERT_THAT( refused );
+    app_event_handler.handle( Events::ButtonClickedEvent( Events::ButtonClickedEvent::play ) );
+    ASSERT_THAT( my_app.is_playing == false );
+
+    app_event_handler.thaw();
+    app_event_handler.register_handler( my_app, &Events::App::on_button_clicked );
+    app_event_handler.handle( Events::ButtonClickedEvent( Events::ButtonClickedEvent::play ) );
+    ASSERT_THAT( my_app.is_playing );
+}
+
+// [ Test #46 ] -------------------------------------------------------
+TEST( "Frozen dispatch tables",
+      "A frozen dispatcher delivers to the same listeners, refuses new subscriptions, stops delivering to unsubscribed listeners right away and is thawed by clear." )
+{
+    cs225::EventDispatcher & event_dispatcher = cs225::EventDispatcher::get_instance();
+    event_dispatcher.clear();
+
+    CountingListener a, b, c;
+    event_dispatcher.subscribe( a, cs225::type_of<TickEvent>() );
+    std::vector<cs225::SubscriptionToken> tokens;
+    tokens.push_back( event_dispatcher.subscribe( b, cs225::type_of<TickEvent>() ) );
+    tokens.push_back( event_dispatcher.subscribe( b, cs225::type_of<TockEvent>() ) );
+    event_dispatcher.subscribe( c, cs225::type_of<TockEvent>() );
+    ASSERT_THAT( event_dispatcher.get_memory_usage().subscriptions == 4u );
+
+    event_dispatcher.freeze();
+    ASSERT_THAT( event_dispatcher.is_frozen() );
+    cs225::trigger_event( TickEvent() );
+    cs225::trigger_event( TockEvent() );
+    ASSERT_THAT( a.count == 1 && b.count == 2 && c.count == 1 );
+
+    bool refused = false;
+    try { event_dispatcher.subscribe( c, cs225::type_of<TickEvent>() ); } catch( const cs225::TableFrozen & ) { refused = true; }
+    ASSERT_THAT( refused );
+
+    // unsubscribing still works while frozen
+    ASSERT_THAT( event_dispatcher.unsubscribe( tokens[0] ) );
+    cs225::trigger_event( TickEvent() );
+    ASSERT_THAT( a.count == 2 && b.count == 2 );
+    event_dispatcher.unsubscribe_all( c );
+    cs225::trigger_event( TockEvent() );
+    ASSERT_THAT( b.count == 3 && c.count == 1 );
+
+    // a type whose listeners all left has no subscribers, lazy events aren't even made
+    ASSERT_THAT( event_dispatcher.has_subscribers<TockEvent>() );
+    event_dispatcher.unsubscribe( tokens[1] );
+    ASSERT_THAT( !event_dispatcher.has_subscribers<TockEvent>() );
+    bool factory_called = false;
+    cs225::trigger_lazy<TockEvent>( [&factory_called]() { factory_called = true; return TockEvent(); } );
+    ASSERT_THAT( !factory_called );
+    ASSERT_THAT( event_dispatcher.has_subscribers<TickEvent>() );
+
+    event_dispatcher.thaw();
+    ASSERT_THAT( !event_dispatcher.has_subscribers<TockEvent>() );
+    event_dispatcher.subscribe( c, cs225::type_of<TickEvent>() );
+    cs225::trigger_event( TickEvent() );
+    ASSERT_THAT( a.count == 3 && c.count == 2 );
+
+    // unsubscribing twice from inside a frozen dispatch leaves a single hole
+    TokenDropper dropper;
+    event_dispatcher.subscribe( dropper, cs225::type_of<TockEvent>() );
+    dropper.token = event_dispatcher.subscribe( a, cs225::type_of<TockEvent>() );
+    event_dispatcher.subscribe( b, cs225::type_of<TockEvent>() );
+    event_dispatcher.freeze();
+    cs225::trigger_event( TockEvent() );
+    ASSERT_THAT( dropper.first && a.count == 3 );
+    event_dispatcher.unsubscribe( b, cs225::type_of<TockEvent>() );
+    ASSERT_THAT( event_dispatcher.has_subscribers<TockEvent>() );
+    event_dispatcher.unsubscribe_all( dropper );
+    ASSERT_THAT( !event_dispatcher.has_subscribers<TockEvent>() );
+    event_dispatcher.thaw();
+
+    event_dispatcher.freeze();
+    event_dispatcher.clear();
+    ASSERT_THAT( !event_dispatcher.is_frozen() );
+    cs225::trigger_event( TickEvent() );
+    ASSERT_THAT( a.count == 3 );
+}
+
+} // namespace FrozenTables
+} // namespace Tests
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include "thread_placement.hh" // cs225::CpuTopology, cs225::ThreadPlacement, cs225::pin_current_thread
+
+/*********************************************************************
+ *                       Thread placement tests                      *
+ *********************************************************************/
+
+namespace Tests { namespace ThreadPlacement
+{
+
+struct LocalEvent : public cs225::Event
+{
+    LocalEvent( int v ) : value(v) {}
+    int value;
+};
+
+// [ Test #47 ] -------------------------------------------------------
+TEST( "Placement policies map worker threads to cores",
+      "Compact placement fills a NUMA node before the next one, scatter goes round robin over the nodes, explicit core lists are used as given. Cpu lists are read in the sysfs format." )
+{
+    ASSERT_THAT( cs225::CpuTopology::parse_list( "0-3,8,10-11\n" ) == std::vector<unsigned>( { 0, 1, 2, 3, 8, 10, 11 } ) );
+    bool rejected = false;
+    try { cs225::CpuTopology::parse_list( "0-3-5" ); } catch( const std::invalid_argument & ) { rejected = true; }
+    ASSERT_THAT( rejected );
+    rejected = false;
+    try { cs225::CpuTopology::parse_list( "0-99999999999999999999" ); } catch( const std::out_of_range & ) { rejected = true; }
+    ASSERT_THAT( rejected );
+    rejected = false;
+    try { cs225::CpuTopology::parse_list( "0-4294967295" ); } catch( const std::out_of_range & ) { rejected = true; }
+    ASSERT_THAT( rejected );
+    ASSERT_THAT( cs225::CpuTopology::parse_list( "1023" ) == std::vector<unsigned>( 1, cs225::CpuTopology::max_cores - 1 ) );
+    rejected = false;
+    try { cs225::CpuTopology::parse_list( "1024" ); } catch( const std::out_of_range & ) { rejected = true; }
+    ASSERT_THAT( rejected );
+
+    // two nodes of two cores, and an empty one (dropped)
+    cs225::CpuTopology topology( { { 0, 1 }, {}, { 4, 5 } } );
+    ASSERT_THAT( topology.get_node_count() == 2u && topology.get_core_count() == 4u );
+    ASSERT_THAT( topology.node_of( 5 ) == 1u );
+
+    const int none = cs225::CpuTopology::no_core;
+    ASSERT_THAT( topology.plan( cs225::ThreadPlacement(), 2 ) == std::vector<int>( { none, none } ) );
+    ASSERT_THAT( topology.plan( cs225::PlacementPolicy::compact, 5 ) == std::vector<int>( { 0, 1, 4, 5, 0 } ) );
+    ASSERT_THAT( topology.plan( cs225::PlacementPolicy::scatter, 5 ) == std::vector<int>( { 0, 4, 1, 5, 0 } ) );
+    cs225::ThreadPlacement listed( cs225::PlacementPolicy::cores, { 5, 1 } );
+    ASSERT_THAT( topology.plan( listed, 3 ) == std::vector<int>( { 5, 1, 5 } ) );
+
+    // whatever the host looks like, it has a core to run on
+    const cs225::CpuTopology & host = cs225::CpuTopology::get_host();
+    ASSERT_THAT( host.get_node_count() >= 1u && host.get_core_count() >= 1u );
+}
+
+// [ Test #48 ] -------------------------------------------------------
+TEST( "Pinned threads run ticks and allocate events from their node",
+      "Scheduler workers are pinned according to the placement, and ticks give the same results as unpinned. A pinned thread takes shared events from the pool of its node, and they go back there when released on another thread." )
+{
+    const cs225::CpuTopology & host = cs225::CpuTopology::get_host();
+    const unsigned first_core = host.get_cores( 0 ).front();
+
+    std::vector<int> cores;
+    {
+        cs225::TickScheduler scheduler( 3u, cs225::PlacementPolicy::compact );
+        scheduler.tick();
+        cores = scheduler.get_worker_cores();
+    }
+    ASSERT_THAT( cores.size() == 2u );
+    #if defined(__linux__)
+        ASSERT_THAT( cores == host.plan( cs225::PlacementPolicy::compact, 2 ) );
+    #endif
+    ASSERT_THAT( TickScheduler::run_mixers( 3u, cs225::PlacementPolicy::scatter ) == TickScheduler::run_mixers( 1u ) );
+
+    // a thread pinned on the second node of a made-up topology
+    cs225::EventPool<LocalEvent> & pool = cs225::EventPool<LocalEvent>::get_instance();
+    cs225::CpuTopology two_nodes( { { first_core + 1 }, { first_core } } );
+    bool pinned = false;
+    std::size_t node = 0;
+    cs225::SharedEvent event;
+    std::thread producer( [&]()
+    {
+        pinned = cs225::pin_current_thread( first_core, two_nodes );
+        node = cs225::current_node();
+        event = cs225::make_shared_event<LocalEvent>( 42 );
+    } );
+    producer.join();
+    #if defined(__linux__)
+        ASSERT_THAT( pinned && node == 1u );
+        ASSERT_THAT( pool.get_capacity( 1 ) > 0u && pool.get_capacity( 0 ) == 0u );
+    #endif
+    ASSERT_THAT( event.as<LocalEvent>().value == 42 && pool.get_in_use() == 1u );
+
+    // released here, it goes back to the list of its node
+    const std::size_t capacity = pool.get_capacity();
+    event.reset();
+    ASSERT_THAT( pool.get_in_use() == 0u && pool.get_capacity() == capacity );
+    ASSERT_THAT( cs225::current_node() == 0u );
+}
+
+} // namespace ThreadPlacement
+} // namespace Tests
+
+
+// ===========================================================================
+// ===========================================================================
+// ===========================================================================
+
+
+#include <cmath>        // std::fabs, std::sqrt
+
+/*********************************************************************
+ *                      Benchmark statistics tests                   *
+ *********************************************************************/
+
+namespace Tests { namespace Benchmarks
+{
+
+// [ Test #49 ] -------------------------------------------------------
+TEST( "Benchmark statistics and baseline regressions",
+      "The statistics of a benchmark are the mean, median, sample standard deviation and nearest-rank p99 of its samples, whatever their order. A mean past the threshold above the baseline is a regression, one at or under it isn't." )
+{
+    std::vector<double> samples( { 9.0, 2.0, 5.0, 4.0, 4.0, 7.0, 5.0, 4.0 } );
+    BenchmarkStatistics stats = compute_statistics( "fixed", 3u, samples );
+    ASSERT_THAT( stats.name == "fixed" && stats.iterations == 3u );
+    ASSERT_THAT( stats.mean == 5.0 );
+    ASSERT_THAT( stats.median == 4.5 );
+    ASSERT_THAT( std::fabs( stats.stddev - std::sqrt( 32.0 / 7.0 ) ) < 1e-12 );
+    ASSERT_THAT( stats.p99 == 9.0 );
+
+    // nearest rank: the 99th of 100 samples is the 99th smallest, not the largest
+    std::vector<double> hundred;
+    for( int i = 100; i >= 1; --i )
+        hundred.push_back( i );
+    stats = compute_statistics( "hundred", 1u, hundred );
+    ASSERT_THAT( stats.p99 == 99.0 && stats.median == 50.5 );
+
+    stats = compute_statistics( "single", 1u, std::vector<double>( 1, 7.0 ) );
+    ASSERT_THAT( stats.mean == 7.0 && stats.median == 7.0 && stats.stddev == 0.0 && stats.p99 == 7.0 );
+
+    ASSERT_THAT( is_regression( 110.001, 100.0, 0.10 ) );
+    ASSERT_THAT( !is_regression( 109.999, 100.0, 0.10 ) );
+    ASSERT_THAT( !is_regression( 110.0, 100.0, 0.10 ) );
+    ASSERT_THAT( !is_regression( 50.0, 100.0, 0.10 ) );
+}
+
+} // namespace Benchmarks
+} // namespace Tests
@@ -36,6 +36,23 @@
  *  It can be activated either by defining the a macro named `VERBOSE` or, preferably, by 
  *  specifying the compiler flag `-DVERBOSE` on the command line or the makefile.
  *
+ *  Besides the sequential `run_all`, `TestSuite::run_parallel` runs the selected tests 
+ *  concurrently on a number of jobs, keeps going past failures, measures the wall time of 
+ *  each test and prints a summary sorted by duration (optionally also writing a JSON report).
+ *  With isolation on (POSIX only) every test runs in its own forked process, so tests that 
+ *  share global state (e.g. a singleton) can run concurrently, and crashes are reported as 
+ *  failures instead of taking the whole run down.
+ *
+ *  The macro `BENCHMARK( "name" )` registers a benchmark the same way `TEST` registers a 
+ *  test. The body receives a `BenchmarkState& state` and times the loop 
+ *  `while( state.keep_running() ) { ... }` (code before and after the loop is not timed). 
+ *  `BenchmarkSuite::run_all` calibrates the iteration count, warms up, takes a number of 
+ *  samples and reports the mean/median/stddev/p99 time per iteration; the results can be 
+ *  saved as a baseline file and later runs compared against it to flag regressions. 
+ *  `do_not_optimize( value )` and `clobber_memory()` keep the optimizer from discarding 
+ *  the benchmarked work. `state.set_counter( "name", value )` reports an extra metric 
+ *  (e.g. a number of dropped items) under the timings.
+ *
  *  @author  Iker Silvano
  */
  
@@ -48,12 +65,30 @@
 //#define USE_COLORED_OUTPUT
 #include "output_coloring.hh"
 
-#include <algorithm>    // std::for_each
+#include <algorithm>    // std::for_each, std::sort
+#include <atomic>       // std::atomic
+#include <chrono>       // std::chrono::steady_clock
+#include <cmath>        // std::sqrt
+#include <cstdio>       // std::snprintf
+#include <cstdlib>      // std::atof
+#include <exception>    // std::exception
+#include <fstream>      // std::ofstream
 #include <iostream>     // std::cout, std::cerr, std::endl
+#include <map>          // std::map
 #include <sstream>      // std::ostringstream
+#include <stdexcept>    // std::runtime_error
 #include <string>       // std::string
+#include <thread>       // std::thread
 #include <vector>       // std::vector
 
+#if defined(__unix__) || defined(__APPLE__)
+    #define TESTING_HAS_FORK
+    #include <cerrno>       // errno, EINTR
+    #include <poll.h>       // poll
+    #include <sys/wait.h>   // waitpid
+    #include <unistd.h>     // fork, pipe, read, write, _exit
+#endif
+
 // print verbose messages about test execution
 // this should be set from the command line with the -DVERBOSE flag
 //#define VERBOSE
@@ -132,6 +167,261 @@ void run( const Test& test )
     #endif
 }
 
+// options for TestSuite::run_parallel
+struct RunOptions
+{
+    RunOptions()
+        : jobs( 1u )
+        , isolate( false )
+    {}
+
+    unsigned int jobs;          // number of tests running at the same time
+    bool isolate;               // run each test in its own process (ignored where fork is unavailable)
+    std::string filter;         // only run tests whose name contains this text (empty: run all)
+    std::string report_path;    // write a JSON report here (empty: no report)
+
+}; // RunOptions
+
+struct TestResult
+{
+    std::size_t index;          // 1-based, as accepted by the driver
+    const Test* test;
+    bool passed;
+    std::string message;        // failure reason
+    double milliseconds;        // wall time
+
+}; // TestResult
+
+// runs a test in-process, turning failures into a result instead of an exception
+TestResult run_timed( const Test& test, std::size_t index )
+{
+    TestResult result = { index, &test, false, "", 0.0 };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    try
+    {
+        test.run();
+        result.passed = true;
+
+    } catch( const AssertionFailed& af ) {
+        result.message = af.reason;
+    } catch( const std::exception& ex ) {
+        result.message = std::string( "Runtime error exception caught: " ) + ex.what();
+    } catch( ... ) {
+        result.message = "An unknown exception was thrown";
+    }
+    result.milliseconds = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+    return result;
+}
+
+// worker threads pick the next pending test until none is left
+void run_threaded( const std::vector<TestResult*>& pending, unsigned int jobs )
+{
+    std::atomic<std::size_t> next( 0u );
+    std::vector<std::thread> workers;
+    for( unsigned int i = 0; i < jobs; ++i )
+    {
+        workers.push_back( std::thread( [&]()
+        {
+            for( std::size_t job = next++; job < pending.size(); job = next++ )
+                *pending[job] = run_timed( *pending[job]->test, pending[job]->index );
+        } ) );
+    }
+    std::for_each( workers.begin(), workers.end(), []( std::thread& worker ) { worker.join(); } );
+}
+
+#ifdef TESTING_HAS_FORK
+// keeps up to `jobs` child processes alive, each running a single test
+// children report the failure reason through a pipe and the verdict through their exit status
+// a child is only reaped once its pipe is closed (it has exited), and by pid: other child
+// processes of the runner (e.g. started by a test) are left to whoever started them
+void run_forked( const std::vector<TestResult*>& pending, unsigned int jobs )
+{
+    struct Child
+    {
+        pid_t pid;
+        int pipe_fd;
+        TestResult* result;
+        std::chrono::steady_clock::time_point start;
+    };
+    // bounds the failure reason a child reports
+    const std::size_t max_message_size = 4096u;
+
+    std::cout.flush(); // children would print the pending output again
+    std::vector<Child> running;
+    std::size_t next = 0u;
+    while( next < pending.size() || !running.empty() )
+    {
+        while( running.size() < jobs && next < pending.size() )
+        {
+            TestResult* result = pending[next++];
+            int fds[2];
+            if( ::pipe( fds ) != 0 )
+            {
+                result->message = "Could not create a pipe for the test process";
+                continue;
+            }
+
+            Child child = { ::fork(), fds[0], result, std::chrono::steady_clock::now() };
+            if( child.pid == 0 )
+            {
+                ::close( fds[0] );
+                TestResult outcome = run_timed( *result->test, result->index );
+                std::string message = outcome.message.substr( 0, max_message_size );
+                if( !message.empty() && ::write( fds[1], message.data(), message.size() ) < 0 )
+                    message.clear();
+                std::cout.flush();
+                ::_exit( outcome.passed ? 0 : 1 );
+            }
+
+            ::close( fds[1] );
+            if( child.pid < 0 )
+            {
+                ::close( fds[0] );
+                result->message = "Could not fork the test process";
+                continue;
+            }
+            running.push_back( child );
+        }
+
+        if( running.empty() )
+            continue;
+        std::vector<pollfd> pipes;
+        for( const Child& child : running )
+            pipes.push_back( pollfd{ child.pipe_fd, POLLIN, 0 } );
+        if( ::poll( pipes.data(), pipes.size(), -1 ) < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            break;
+        }
+
+        // backwards, finished children are erased
+        for( std::size_t i = running.size(); i-- > 0; )
+        {
+            if( pipes[i].revents == 0 )
+                continue;
+
+            TestResult* result = running[i].result;
+            char buffer[512];
+            ssize_t count = ::read( running[i].pipe_fd, buffer, sizeof(buffer) );
+            if( count > 0 )
+            {
+                result->message.append( buffer, static_cast<std::size_t>(count) );
+                continue;
+            }
+            if( count < 0 && errno == EINTR )
+                continue;
+
+            // end of file: the child is gone (or going)
+            ::close( running[i].pipe_fd );
+            int status = 0;
+            pid_t finished;
+            while( ( finished = ::waitpid( running[i].pid, &status, 0 ) ) < 0 && errno == EINTR ) {}
+            result->milliseconds = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - running[i].start ).count();
+
+            result->passed = finished == running[i].pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            if( finished != running[i].pid )
+            {
+                result->message = "Could not wait for the test process";
+            }
+            else if( WIFSIGNALED(status) )
+            {
+                std::ostringstream oss;
+                oss << "The test process was terminated by signal " << WTERMSIG(status);
+                result->message = oss.str();
+            }
+
+            running.erase( running.begin() + i );
+        }
+    }
+}
+#endif
+
+std::string json_escape( const std::string& text )
+{
+    std::string escaped;
+    for( char c : text )
+    {
+        switch( c )
+        {
+            case '"':  escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if( static_cast<unsigned char>(c) < 0x20 )
+                {
+                    char code[8];
+                    std::snprintf( code, sizeof(code), "\\u%04x", c );
+                    escaped += code;
+                }
+                else
+                    escaped += c;
+        }
+    }
+    return escaped;
+}
+
+void write_report( const std::vector<TestResult>& results, double total_milliseconds, const std::string& path )
+{
+    std::ofstream report( path.c_str() );
+    std::size_t failed = std::count_if( results.begin(), results.end(), []( const TestResult& r ) { return !r.passed; } );
+
+    report << "{\n  \"passed\": " << results.size() - failed
+           << ",\n  \"failed\": " << failed
+           << ",\n  \"milliseconds\": " << total_milliseconds
+           << ",\n  \"tests\": [";
+    for( std::size_t i = 0; i < results.size(); ++i )
+    {
+        const TestResult& r = results[i];
+        report << ( i ? "," : "" ) << "\n    { \"index\": " << r.index
+               << ", \"name\": \"" << json_escape( r.test->name() )
+               << "\", \"status\": \"" << ( r.passed ? "passed" : "failed" )
+               << "\", \"milliseconds\": " << r.milliseconds
+               << ", \"message\": \"" << json_escape( r.message ) << "\" }";
+    }
+    report << "\n  ]\n}\n";
+}
+
+// failures first (with their reason), then every test sorted by decreasing duration
+void print_summary( std::vector<TestResult> results, double total_milliseconds )
+{
+    std::size_t failed = 0u;
+    for( const TestResult& r : results )
+    {
+        if( r.passed )
+            continue;
+        failed++;
+
+        std::ostringstream oss;
+        oss << "Test " << r.index << " '" << r.test->name() << "' failed";
+        print( oss.str(), colors::red );
+        std::cout << "\nReason: ";
+        print( r.message, colors::yellow );
+        std::cout << "\nCheck the test description: ";
+        print( r.test->description(), colors::yellow );
+        std::cout << "\n\n";
+    }
+
+    std::sort( results.begin(), results.end(), []( const TestResult& a, const TestResult& b )
+    {
+        return a.milliseconds > b.milliseconds;
+    } );
+    for( const TestResult& r : results )
+    {
+        char duration[32];
+        std::snprintf( duration, sizeof(duration), "%10.3f ms  ", r.milliseconds );
+        std::cout << duration;
+        print( r.passed ? "[PASS] " : "[FAIL] ", r.passed ? colors::green : colors::red );
+        std::cout << r.index << " '" << r.test->name() << "'\n";
+    }
+
+    std::ostringstream oss;
+    oss << "\n" << results.size() - failed << " passed, " << failed << " failed, "
+        << total_milliseconds << " ms in total\n";
+    print( oss.str(), failed ? colors::red : colors::green );
+}
+
 class TestSuite 
 {
 public:
@@ -146,20 +436,350 @@ public:
         std::for_each( registered_tests.begin(), registered_tests.end(), ::testing::run );
     }
 
+    static std::size_t test_count()
+    {
+        return registered_tests.size();
+    }
+
     static void run_test( std::size_t index )
     {
         ::testing::run( registered_tests.at(index) );
     }
 
+    // runs every selected test (even past failures) and prints a timing summary
+    // returns true if all of them passed
+    static bool run_parallel( const RunOptions& options )
+    {
+        std::vector<TestResult> results;
+        for( std::size_t i = 0; i < registered_tests.size(); ++i )
+        {
+            if( registered_tests[i].name().find( options.filter ) == std::string::npos )
+                continue;
+            TestResult pending = { i + 1u, &registered_tests[i], false, "", 0.0 };
+            results.push_back( pending );
+        }
+
+        std::vector<TestResult*> pending;
+        for( TestResult& r : results )
+            pending.push_back( &r );
+        unsigned int jobs = std::max( options.jobs, 1u );
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        #ifdef TESTING_HAS_FORK
+            if( options.isolate )
+                run_forked( pending, jobs );
+            else
+        #endif
+                run_threaded( pending, jobs );
+        double total_milliseconds = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+
+        print_summary( results, total_milliseconds );
+        if( !options.report_path.empty() )
+            write_report( results, total_milliseconds, options.report_path );
+
+        return std::all_of( results.begin(), results.end(), []( const TestResult& r ) { return r.passed; } );
+    }
+
 private:
     static std::vector<Test> registered_tests;
 
 }; // TestSuite
 
+/*********************************************************************
+ *                            Benchmarks                             *
+ *********************************************************************/
+
+// forces the compiler to materialize `value` (it can't be optimized away)
+template <typename T>
+inline void do_not_optimize( const T& value )
+{
+    #if defined(__GNUC__)
+        __asm__ __volatile__( "" : : "r,m"(value) : "memory" );
+    #else
+        static volatile const void* sink;
+        sink = &value;
+    #endif
+}
+
+// forces pending memory writes to be considered observable
+inline void clobber_memory()
+{
+    #if defined(__GNUC__)
+        __asm__ __volatile__( "" : : : "memory" );
+    #else
+        std::atomic_signal_fence( std::memory_order_seq_cst );
+    #endif
+}
+
+// drives the timed loop of a benchmark body
+class BenchmarkState
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    explicit BenchmarkState( std::size_t iterations )
+        : remaining( iterations )
+        , total( iterations )
+        , started( false )
+    {}
+
+    // the timer starts on the first call and stops when the iterations run out
+    bool keep_running()
+    {
+        if( !started )
+        {
+            started = true;
+            start = clock::now();
+        }
+        if( remaining == 0u )
+        {
+            stop = clock::now();
+            return false;
+        }
+        --remaining;
+        return true;
+    }
+
+    std::size_t iterations() const { return total; }
+    bool finished() const { return started && remaining == 0u; }
+    double elapsed_nanoseconds() const { return std::chrono::duration<double, std::nano>( stop - start ).count(); }
+
+    // extra metric reported next to the timings (e.g. items dropped), the last sample's value is kept
+    void set_counter( const std::string& name, double value ) { counters[name] = value; }
+    const std::map<std::string, double>& get_counters() const { return counters; }
+
+private:
+    std::map<std::string, double> counters;
+    std::size_t remaining;
+    std::size_t total;
+    bool started;
+    clock::time_point start;
+    clock::time_point stop;
+
+}; // BenchmarkState
+
+class Benchmark
+{
+public:
+    typedef void (*function_type)( BenchmarkState& );
+
+    Benchmark( function_type fn, const std::string& nm )
+        : func( fn )
+        , benchmark_name( nm )
+    {}
+
+    // runs the body once for the given number of iterations and returns the time per iteration
+    // the counters set by the body are stored in counters when given
+    double run( std::size_t iterations, std::map<std::string, double>* counters = nullptr ) const
+    {
+        BenchmarkState state( iterations );
+        func( state );
+        if( !state.finished() )
+            throw std::runtime_error( "benchmark '" + benchmark_name + "' did not exhaust its keep_running() loop" );
+        if( counters )
+            *counters = state.get_counters();
+        return state.elapsed_nanoseconds() / static_cast<double>( iterations );
+    }
+    const std::string& name() const { return benchmark_name; }
+
+private:
+    function_type func;
+    std::string benchmark_name;
+
+}; // Benchmark
+
+// options for BenchmarkSuite::run_all
+struct BenchmarkOptions
+{
+    BenchmarkOptions()
+        : samples( 20u )
+        , min_sample_ms( 5.0 )
+        , warmup_ms( 20.0 )
+        , threshold( 0.10 )
+    {}
+
+    std::size_t samples;        // number of timed samples per benchmark
+    double min_sample_ms;       // iteration count is calibrated so that each sample takes at least this long
+    double warmup_ms;           // untimed run before sampling
+    double threshold;           // relative slowdown of the mean (vs the baseline) reported as a regression
+    std::string filter;         // only run benchmarks whose name contains this text (empty: run all)
+    std::string baseline_path;  // compare against this baseline file (empty: no comparison)
+    std::string save_path;      // save the results as a baseline file (empty: don't save)
+
+}; // BenchmarkOptions
+
+// all times in nanoseconds per iteration, computed over the per-sample means
+struct BenchmarkStatistics
+{
+    std::string name;
+    std::size_t iterations;     // per sample
+    double mean;
+    double median;
+    double stddev;
+    double p99;
+    std::map<std::string, double> counters;    // as set by the body in the last sample
+
+}; // BenchmarkStatistics
+
+BenchmarkStatistics compute_statistics( const std::string& name, std::size_t iterations, std::vector<double> samples )
+{
+    std::sort( samples.begin(), samples.end() );
+    const std::size_t n = samples.size();
+
+    double sum = 0.0;
+    for( double sample : samples )
+        sum += sample;
+    double mean = sum / n;
+
+    double squares = 0.0;
+    for( double sample : samples )
+        squares += ( sample - mean ) * ( sample - mean );
+
+    BenchmarkStatistics stats;
+    stats.name = name;
+    stats.iterations = iterations;
+    stats.mean = mean;
+    stats.median = n % 2 ? samples[n / 2] : ( samples[n / 2 - 1] + samples[n / 2] ) / 2.0;
+    stats.stddev = n > 1 ? std::sqrt( squares / ( n - 1 ) ) : 0.0;
+    // nearest rank
+    stats.p99 = samples[ std::min( n - 1, static_cast<std::size_t>( std::ceil( 0.99 * n ) ) - 1 ) ];
+    return stats;
+}
+
+BenchmarkStatistics measure( const Benchmark& benchmark, const BenchmarkOptions& options )
+{
+    // calibration: grow the iteration count until a single sample is long enough
+    const double min_sample_ns = options.min_sample_ms * 1e6;
+    std::size_t iterations = 1u;
+    double per_iteration = benchmark.run( iterations );
+    while( per_iteration * iterations < min_sample_ns )
+    {
+        // aim a bit past the target, but never grow more than 10x at once
+        double wanted = 1.2 * min_sample_ns / std::max( per_iteration, 1e-3 );
+        iterations = static_cast<std::size_t>( std::min( wanted, 10.0 * iterations ) ) + 1u;
+        per_iteration = benchmark.run( iterations );
+    }
+
+    // warmup
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while( std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() < options.warmup_ms )
+        benchmark.run( iterations );
+
+    std::vector<double> samples;
+    std::map<std::string, double> counters;
+    for( std::size_t i = 0; i < std::max<std::size_t>( options.samples, 1u ); ++i )
+        samples.push_back( benchmark.run( iterations, &counters ) );
+
+    BenchmarkStatistics stats = compute_statistics( benchmark.name(), iterations, samples );
+    stats.counters = counters;
+    return stats;
+}
+
+// baseline files hold one "<name>\t<mean ns per iteration>" line per benchmark
+std::map<std::string, double> load_baseline( const std::string& path )
+{
+    std::map<std::string, double> baseline;
+    std::ifstream file( path.c_str() );
+    std::string line;
+    while( std::getline( file, line ) )
+    {
+        std::size_t tab = line.rfind( '\t' );
+        if( tab != std::string::npos )
+            baseline[ line.substr( 0, tab ) ] = std::atof( line.c_str() + tab + 1 );
+    }
+    return baseline;
+}
+
+void save_baseline( const std::vector<BenchmarkStatistics>& results, const std::string& path )
+{
+    std::ofstream file( path.c_str() );
+    for( const BenchmarkStatistics& stats : results )
+        file << stats.name << '\t' << stats.mean << '\n';
+}
+
+// a mean more than threshold (relative) above the baseline mean is a regression
+bool is_regression( double mean, double baseline_mean, double threshold )
+{
+    return mean > baseline_mean * ( 1.0 + threshold );
+}
+
+void print_statistics( const BenchmarkStatistics& stats )
+{
+    char line[160];
+    std::snprintf( line, sizeof(line), "%12.2f %12.2f %12.2f %12.2f %12zu  ",
+                   stats.mean, stats.median, stats.stddev, stats.p99, stats.iterations );
+    std::cout << line << stats.name << std::endl;
+    if( !stats.counters.empty() )
+    {
+        std::ostringstream oss;
+        oss << "             ";
+        for( std::map<std::string, double>::const_iterator it = stats.counters.begin(); it != stats.counters.end(); ++it )
+            oss << ' ' << it->first << '=' << it->second;
+        std::cout << oss.str() << std::endl;
+    }
+}
+
+class BenchmarkSuite
+{
+public:
+    static bool register_benchmark( Benchmark::function_type fn, const char* name )
+    {
+        registered_benchmarks.push_back( Benchmark(fn, name) );
+        return true;
+    }
+
+    // runs the selected benchmarks and prints their statistics
+    // returns false if any of them regressed against the baseline
+    static bool run_all( const BenchmarkOptions& options )
+    {
+        std::map<std::string, double> baseline;
+        if( !options.baseline_path.empty() )
+            baseline = load_baseline( options.baseline_path );
+
+        std::cout << "   mean (ns)  median (ns)  stddev (ns)     p99 (ns)   iterations  benchmark\n";
+
+        bool regressed = false;
+        std::vector<BenchmarkStatistics> results;
+        for( const Benchmark& benchmark : registered_benchmarks )
+        {
+            if( benchmark.name().find( options.filter ) == std::string::npos )
+                continue;
+
+            BenchmarkStatistics stats = measure( benchmark, options );
+            print_statistics( stats );
+            results.push_back( stats );
+
+            std::map<std::string, double>::const_iterator previous = baseline.find( stats.name );
+            if( previous != baseline.end() && previous->second > 0.0 )
+            {
+                double change = stats.mean / previous->second - 1.0;
+                std::ostringstream oss;
+                oss << "             " << ( change >= 0.0 ? "+" : "" ) << change * 100.0 << "% vs baseline";
+                if( is_regression( stats.mean, previous->second, options.threshold ) )
+                {
+                    regressed = true;
+                    print( oss.str() + " (REGRESSION)\n", colors::red );
+                }
+                else
+                    print( oss.str() + "\n", change < 0.0 ? colors::green : colors::white );
+            }
+        }
+
+        if( !options.save_path.empty() )
+            save_baseline( results, options.save_path );
+        return !regressed;
+    }
+
+private:
+    static std::vector<Benchmark> registered_benchmarks;
+
+}; // BenchmarkSuite
+
 // static initialization
 // caveat: this being instantiated here implies that there shouldn't
 // be more than one translation unit including this header
 std::vector<Test> TestSuite::registered_tests;
+std::vector<Benchmark> BenchmarkSuite::registered_benchmarks;
 
 } // namespace testing
 
@@ -199,3 +819,14 @@ std::vector<Test> TestSuite::registered_tests;
 #define TEST( name, description )                                       \
     REGISTER_TEST( name, description, __LINE__ )
 
+#define REGISTER_BENCHMARK_IMPL( fn_name, var_name, name )              \
+    static void fn_name( testing::BenchmarkState& state );              \
+    static volatile bool var_name = testing::BenchmarkSuite::register_benchmark(fn_name, name); \
+    void fn_name( testing::BenchmarkState& state )
+
+#define REGISTER_BENCHMARK( name, line )                                \
+    REGISTER_BENCHMARK_IMPL( CONCAT(benchmark_fn_, line), CONCAT(benchmark_sink_, line), name )
+
+#define BENCHMARK( name )                                               \
+    REGISTER_BENCHMARK( name, __LINE__ )
+
@@ -0,0 +1,217 @@
+#include "thread_placement.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+
+    static_assert(cs225::CpuTopology::max_cores <= CPU_SETSIZE, "cores past CPU_SETSIZE can't be pinned");
+#endif
+
+namespace cs225
+{
+    const int CpuTopology::no_core;
+    const unsigned CpuTopology::max_cores;
+
+    namespace
+    {
+        // the cores the process may run on (empty if unknown)
+        std::vector<unsigned> allowed_cores()
+        {
+            std::vector<unsigned> cores;
+            #if defined(__linux__)
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                if (sched_getaffinity(0, sizeof(set), &set) == 0)
+                {
+                    for (unsigned core = 0; core < CPU_SETSIZE; ++core)
+                    {
+                        if (CPU_ISSET(core, &set))
+                            cores.push_back(core);
+                    }
+                }
+            #endif
+            return cores;
+        }
+
+        // std::stoul throws std::out_of_range past unsigned long, so must this past unsigned
+        unsigned to_unsigned(const std::string& digits)
+        {
+            const unsigned long value = std::stoul(digits);
+            if (value >= CpuTopology::max_cores)
+                throw std::out_of_range("cpu number " + digits + " out of range");
+            return static_cast<unsigned>(value);
+        }
+
+        bool read_line(const std::string& path, std::string& line)
+        {
+            std::ifstream file(path);
+            return static_cast<bool>(std::getline(file, line));
+        }
+
+        CpuTopology detect_host()
+        {
+            std::vector<unsigned> allowed = allowed_cores();
+            if (allowed.empty())
+            {
+                for (unsigned core = 0; core < std::max(1u, std::thread::hardware_concurrency()); ++core)
+                    allowed.push_back(core);
+            }
+
+            std::vector<std::vector<unsigned>> nodes;
+            std::string line;
+            if (read_line("/sys/devices/system/node/online", line))
+            {
+                try
+                {
+                    for (unsigned node : CpuTopology::parse_list(line))
+                    {
+                        std::string cpus;
+                        if (!read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", cpus))
+                            continue;
+                        std::vector<unsigned> cores;
+                        for (unsigned core : CpuTopology::parse_list(cpus))
+                        {
+                            if (std::binary_search(allowed.begin(), allowed.end(), core))
+                                cores.push_back(core);
+                        }
+                        nodes.push_back(cores);
+                    }
+                }
+                catch (const std::exception&)
+                {
+                    // malformed or out of range: fall back to a single node
+                    nodes.clear();
+                }
+            }
+
+            CpuTopology topology(nodes);
+            if (topology.get_core_count() != allowed.size())
+                return CpuTopology(std::vector<std::vector<unsigned>>(1, allowed));
+            return topology;
+        }
+    }
+
+    const CpuTopology& CpuTopology::get_host()
+    {
+        static const CpuTopology host = detect_host();
+        return host;
+    }
+
+    CpuTopology::CpuTopology(const std::vector<std::vector<unsigned>>& node_cores)
+    {
+        for (const std::vector<unsigned>& cores : node_cores)
+        {
+            if (!cores.empty())
+                nodes.push_back(cores);
+        }
+    }
+
+    std::size_t CpuTopology::get_core_count() const
+    {
+        std::size_t count = 0;
+        for (const std::vector<unsigned>& cores : nodes)
+            count += cores.size();
+        return count;
+    }
+
+    std::size_t CpuTopology::node_of(unsigned core) const
+    {
+        for (std::size_t node = 0; node < nodes.size(); ++node)
+        {
+            if (std::find(nodes[node].begin(), nodes[node].end(), core) != nodes[node].end())
+                return node;
+        }
+        return 0;
+    }
+
+    std::vector<int> CpuTopology::plan(const ThreadPlacement& placement, std::size_t threads) const
+    {
+        std::vector<int> cores(threads, no_core);
+        if (nodes.empty())
+            return cores;
+
+        for (std::size_t thread = 0; thread < threads; ++thread)
+        {
+            switch (placement.policy)
+            {
+                case PlacementPolicy::none:
+                    break;
+                case PlacementPolicy::compact:
+                {
+                    // more threads than cores wrap around
+                    std::size_t index = thread % get_core_count();
+                    std::size_t node = 0;
+                    while (index >= nodes[node].size())
+                        index -= nodes[node++].size();
+                    cores[thread] = static_cast<int>(nodes[node][index]);
+                    break;
+                }
+                case PlacementPolicy::scatter:
+                {
+                    const std::vector<unsigned>& node = nodes[thread % nodes.size()];
+                    cores[thread] = static_cast<int>(node[(thread / nodes.size()) % node.size()]);
+                    break;
+                }
+                case PlacementPolicy::cores:
+                    if (!placement.cores.empty())
+                        cores[thread] = static_cast<int>(placement.cores[thread % placement.cores.size()]);
+                    break;
+            }
+        }
+        return cores;
+    }
+
+    std::vector<unsigned> CpuTopology::parse_list(const std::string& list)
+    {
+        std::vector<unsigned> values;
+        std::size_t begin = 0;
+        while (begin < list.size() && list[begin] != '\n')
+        {
+            std::size_t end = list.find_first_of(",\n", begin);
+            if (end == std::string::npos)
+                end = list.size();
+            const std::string range = list.substr(begin, end - begin);
+            const std::size_t dash = range.find('-');
+            if (range.empty() || range.find_first_not_of("0123456789-") != std::string::npos ||
+                dash == 0 || dash == range.size() - 1 ||
+                (dash != std::string::npos && range.find('-', dash + 1) != std::string::npos))
+            {
+                throw std::invalid_argument("malformed cpu list '" + list + "'");
+            }
+
+            const unsigned first = to_unsigned(range.substr(0, dash));
+            const unsigned last = dash == std::string::npos ? first : to_unsigned(range.substr(dash + 1));
+            if (last < first)
+                throw std::invalid_argument("malformed cpu list '" + list + "'");
+            for (unsigned value = first; value <= last; ++value)
+                values.push_back(value);
+
+            begin = end < list.size() && list[end] == ',' ? end + 1 : end;
+        }
+        return values;
+    }
+
+    bool pin_current_thread(unsigned core, const CpuTopology& topology)
+    {
+        #if defined(__linux__)
+            if (core >= CPU_SETSIZE)
+                return false;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(core, &set);
+            if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+                return false;
+            detail::thread_node() = topology.node_of(core);
+            return true;
+        #else
+            (void)core;
+            (void)topology;
+            return false;
+        #endif
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace cs225
+{
+    // where worker threads run:
+    // - none: wherever the OS schedules them
+    // - compact: on consecutive cores, filling a NUMA node before using the next one
+    //   (threads that share events share caches and memory)
+    // - scatter: round robin over the nodes (each thread gets as much memory bandwidth as possible)
+    // - cores: on the listed cores, thread i on cores[i % cores.size()]
+    enum class PlacementPolicy { none, compact, scatter, cores };
+
+    struct ThreadPlacement
+    {
+        ThreadPlacement(PlacementPolicy placement_policy = PlacementPolicy::none,
+                        const std::vector<unsigned>& core_list = std::vector<unsigned>())
+            : policy{placement_policy}, cores(core_list)
+        {}
+
+        PlacementPolicy policy;
+        std::vector<unsigned> cores;    // for PlacementPolicy::cores
+    };
+
+    // the cores this process may run on, grouped by NUMA node
+    // nodes are numbered densely from 0, in the order of the OS node ids
+    class CpuTopology
+    {
+    public:
+        // a core that is not pinned (in a placement plan)
+        static const int no_core = -1;
+        // cores (and nodes) are numbered below this, the size of a Linux cpu_set_t
+        static const unsigned max_cores = 1024;
+
+        // read from sysfs and the process affinity mask on Linux; a single node with every
+        // hardware thread elsewhere (or if sysfs can't be read)
+        static const CpuTopology& get_host();
+
+        // nodes without cores are dropped
+        explicit CpuTopology(const std::vector<std::vector<unsigned>>& node_cores);
+
+        std::size_t get_node_count() const { return nodes.size(); }
+        const std::vector<unsigned>& get_cores(std::size_t node) const { return nodes[node]; }
+        std::size_t get_core_count() const;
+        // the node of a core (0 if the core is unknown)
+        std::size_t node_of(unsigned core) const;
+
+        // the core of each of threads threads (no_core if it isn't pinned)
+        std::vector<int> plan(const ThreadPlacement& placement, std::size_t threads) const;
+
+        // parses a sysfs cpu list ("0-3,8,10-11"); throws std::invalid_argument if malformed,
+        // std::out_of_range if a number isn't below max_cores
+        static std::vector<unsigned> parse_list(const std::string& list);
+    private:
+        std::vector<std::vector<unsigned>> nodes;
+    };
+
+    // pins the calling thread to a core and records its node (see current_node)
+    // returns false if the core can't be used (or pinning isn't supported on this platform)
+    bool pin_current_thread(unsigned core, const CpuTopology& topology = CpuTopology::get_host());
+
+    namespace detail
+    {
+        inline std::size_t& thread_node()
+        {
+            static thread_local std::size_t node = 0;
+            return node;
+        }
+    }
+
+    // the NUMA node of the calling thread, as recorded when it was pinned (0 if it never was)
+    // memory is placed on the node of the thread that first touches it, so node-local pools
+    // are grown by the threads that use them
+    inline std::size_t current_node()
+    {
+        return detail::thread_node();
+    }
+}
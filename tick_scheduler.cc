@@ -0,0 +1,236 @@
+#include "tick_scheduler.hh"
+
+#include <algorithm>
+
+namespace cs225
+{
+    TickScheduler::TickScheduler(std::size_t threads, const ThreadPlacement& placement)
+        : graph_built{false}, tick_count{0}, ready(CpuTopology::get_host().get_node_count())
+        , ready_count{0}, completed{0}, stopping{false}
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        worker_cores = CpuTopology::get_host().plan(placement, threads - 1);
+        for (std::size_t i = 1; i < threads; ++i)
+        {
+            const int core = worker_cores[i - 1];
+            workers.emplace_back([this, i, core]()
+            {
+                if (core != CpuTopology::no_core && !pin_current_thread(static_cast<unsigned>(core)))
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    worker_cores[i - 1] = CpuTopology::no_core;
+                }
+                work(false);
+            });
+        }
+    }
+
+    TickScheduler::~TickScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        ready_or_done.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    std::size_t TickScheduler::add_system(TickSystem& system, const std::vector<TypeInfo>& consumes,
+                                          const std::vector<TypeInfo>& produces)
+    {
+        std::unique_ptr<SystemEntry> entry(new SystemEntry);
+        entry->system = &system;
+        entry->consumes = consumes;
+        entry->produces = produces;
+        entry->current.resize(produces.size());
+        entry->previous.resize(produces.size());
+        entry->predecessors = 0;
+        entry->node = 0;
+        systems.push_back(std::move(entry));
+        graph_built = false;
+        return systems.size() - 1;
+    }
+
+    void TickScheduler::post(const SharedEvent& event)
+    {
+        posted.push_back(event);
+    }
+
+    void TickScheduler::build_graph()
+    {
+        // a producer runs before the consumers registered after it
+        for (std::size_t consumer = 0; consumer < systems.size(); ++consumer)
+        {
+            SystemEntry& entry = *systems[consumer];
+            entry.sources.assign(entry.consumes.size(), std::vector<Source>());
+            entry.successors.clear();
+            entry.predecessors = 0;
+        }
+        for (std::size_t consumer = 0; consumer < systems.size(); ++consumer)
+        {
+            SystemEntry& entry = *systems[consumer];
+            for (std::size_t producer = 0; producer < systems.size(); ++producer)
+            {
+                const std::vector<TypeInfo>& produces = systems[producer]->produces;
+                bool depends = false;
+                for (std::size_t i = 0; i < entry.consumes.size(); ++i)
+                {
+                    auto slot_it = std::find(produces.begin(), produces.end(), entry.consumes[i]);
+                    if (slot_it == produces.end())
+                        continue;
+                    entry.sources[i].push_back(Source{producer, static_cast<std::size_t>(slot_it - produces.begin())});
+                    depends = depends || producer < consumer;
+                }
+                if (depends)
+                {
+                    systems[producer]->successors.push_back(consumer);
+                    entry.predecessors++;
+                }
+            }
+        }
+        graph_built = true;
+    }
+
+    void TickScheduler::tick()
+    {
+        if (!graph_built)
+            build_graph();
+        if (systems.empty())
+        {
+            tick_count++;
+            return;
+        }
+
+        external.swap(posted);
+        posted.clear();
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            completed = 0;
+            for (std::size_t i = 0; i < systems.size(); ++i)
+            {
+                systems[i]->waiting_for = systems[i]->predecessors;
+                systems[i]->failure = nullptr;
+                if (systems[i]->predecessors == 0)
+                    make_ready(i);
+            }
+        }
+        ready_or_done.notify_all();
+        work(true);
+
+        // this tick's events become last tick's
+        std::exception_ptr failure;
+        for (std::unique_ptr<SystemEntry>& entry : systems)
+        {
+            entry->previous.swap(entry->current);
+            for (std::vector<SharedEvent>& events : entry->current)
+                events.clear();
+            if (!failure)
+                failure = entry->failure;
+        }
+        tick_count++;
+        if (failure)
+            std::rethrow_exception(failure);
+    }
+
+    std::vector<int> TickScheduler::get_worker_cores() const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return worker_cores;
+    }
+
+    void TickScheduler::run_system(std::size_t index)
+    {
+        SystemEntry& entry = *systems[index];
+        entry.node = current_node() < ready.size() ? current_node() : 0;
+        try
+        {
+            TickContext context(*this, index);
+            entry.system->update(context);
+        }
+        catch (...)
+        {
+            entry.failure = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        for (std::size_t successor : entry.successors)
+        {
+            if (--systems[successor]->waiting_for == 0)
+                make_ready(successor);
+        }
+        completed++;
+        ready_or_done.notify_all();
+    }
+
+    void TickScheduler::work(bool until_tick_done)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true)
+        {
+            ready_or_done.wait(guard, [&]()
+            {
+                return stopping || ready_count != 0 || (until_tick_done && completed == systems.size());
+            });
+            if (until_tick_done && completed == systems.size())
+                return;
+            if (ready_count == 0)
+                return; // stopping
+
+            std::size_t index = take_ready(current_node());
+            guard.unlock();
+            run_system(index);
+            guard.lock();
+        }
+    }
+
+    void TickScheduler::make_ready(std::size_t index)
+    {
+        ready[systems[index]->node].push_back(index);
+        ready_count++;
+    }
+
+    std::size_t TickScheduler::take_ready(std::size_t node)
+    {
+        if (node >= ready.size() || ready[node].empty())
+        {
+            node = 0;
+            while (ready[node].empty())
+                node++;
+        }
+        std::size_t index = ready[node].front();
+        ready[node].pop_front();
+        ready_count--;
+        return index;
+    }
+
+    std::size_t TickContext::count(const TypeInfo& type) const
+    {
+        std::size_t total = 0;
+        for (const SharedEvent& event : scheduler.external)
+            total += event.get_type() == type;
+        for (const TickScheduler::Source& source : scheduler.systems[self]->sources[consumed_slot(type)])
+            total += input(source).size();
+        return total;
+    }
+
+    std::size_t TickContext::consumed_slot(const TypeInfo& type) const
+    {
+        const std::vector<TypeInfo>& consumes = scheduler.systems[self]->consumes;
+        auto found_it = std::find(consumes.begin(), consumes.end(), type);
+        if (found_it == consumes.end())
+            throw UndeclaredEventType(std::string("system does not consume ") + type.get_name());
+        return found_it - consumes.begin();
+    }
+
+    std::vector<SharedEvent>& TickContext::output(const TypeInfo& type)
+    {
+        TickScheduler::SystemEntry& entry = *scheduler.systems[self];
+        auto found_it = std::find(entry.produces.begin(), entry.produces.end(), type);
+        if (found_it == entry.produces.end())
+            throw UndeclaredEventType(std::string("system does not produce ") + type.get_name());
+        return entry.current[found_it - entry.produces.begin()];
+    }
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "event.hh"
+#include "shared_event.hh"
+#include "thread_placement.hh"
+#include "type_info.hh"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cs225
+{
+    class TickContext;
+
+    // a stage of a tick-based simulation, run once per tick by a TickScheduler
+    class TickSystem
+    {
+    public:
+        virtual ~TickSystem() {}
+        virtual void update(TickContext& context) = 0;
+    };
+
+    // thrown when a system reads or emits an event type it didn't declare
+    class UndeclaredEventType : public std::logic_error
+    {
+    public:
+        explicit UndeclaredEventType(const std::string& what) : std::logic_error(what)
+        {}
+    };
+
+    // runs a set of systems once per tick, in parallel as far as their event types allow
+    //
+    // every system declares the event types it consumes and produces; events travel between
+    // systems through per-producer, double-buffered queues:
+    // - a consumer registered after a producer runs after it, and sees its events in the same tick
+    // - a consumer registered before a producer (or the producer itself) sees them in the next tick
+    // - posted events are seen by every consumer in the next tick
+    // so each consumer sees each event exactly once, always in the same order (posted events
+    // first, then by producer registration order and emission order), whatever the number of
+    // threads: results are deterministic as long as systems only communicate through events
+    //
+    // the worker threads can be pinned to cores; then ready systems are queued per NUMA node
+    // and each system sticks to the node of the thread that last ran it (an idle thread takes
+    // systems from other nodes), so that its event buffers, grown by that thread, stay local
+    class TickScheduler
+    {
+    public:
+        // threads counts the calling thread, which runs systems too (0: one per hardware thread)
+        // the placement applies to the other threads: the calling thread is left as it is
+        explicit TickScheduler(std::size_t threads = 0, const ThreadPlacement& placement = ThreadPlacement());
+        TickScheduler(const TickScheduler&) = delete;
+        TickScheduler& operator=(const TickScheduler&) = delete;
+        ~TickScheduler();
+
+        // the system must outlive the scheduler; returns its position (its registration order)
+        std::size_t add_system(TickSystem& system, const std::vector<TypeInfo>& consumes,
+                               const std::vector<TypeInfo>& produces);
+
+        // queues an event from outside the systems for the next tick (not while ticking)
+        void post(const SharedEvent& event);
+        template <typename E>
+        void post(const E& event) { post(make_shared_event<E>(event)); }
+
+        // runs every system once; if some of them throw, the tick still completes and
+        // the first exception (in registration order) is rethrown afterwards
+        void tick();
+
+        std::uint64_t get_tick_count() const { return tick_count; }
+        std::size_t get_thread_count() const { return workers.size() + 1; }
+        // the core each worker thread is pinned to (CpuTopology::no_core if it isn't)
+        std::vector<int> get_worker_cores() const;
+    private:
+        friend class TickContext;
+
+        struct Source
+        {
+            std::size_t producer;
+            std::size_t slot;
+        };
+
+        struct SystemEntry
+        {
+            TickSystem* system;
+            std::vector<TypeInfo> consumes;
+            std::vector<TypeInfo> produces;
+            // per consumed type, the producers of that type, in registration order
+            std::vector<std::vector<Source>> sources;
+            // per produced type: emitted this tick, and emitted last tick
+            std::vector<std::vector<SharedEvent>> current;
+            std::vector<std::vector<SharedEvent>> previous;
+
+            std::vector<std::size_t> successors;
+            std::size_t predecessors;
+            std::size_t node;               // of the thread that last ran it
+            std::size_t waiting_for;        // predecessors still running this tick
+            std::exception_ptr failure;
+        };
+
+        void build_graph();
+        void run_system(std::size_t index);
+        // runs ready systems until the tick is complete (or the scheduler is stopping)
+        void work(bool until_tick_done);
+        void make_ready(std::size_t index);
+        // the next ready system, preferably one of the node (call it with ready_count > 0)
+        std::size_t take_ready(std::size_t node);
+
+        std::vector<std::unique_ptr<SystemEntry>> systems;
+        bool graph_built;
+        std::vector<SharedEvent> posted;
+        std::vector<SharedEvent> external;  // posted before this tick
+        std::uint64_t tick_count;
+
+        std::vector<std::thread> workers;
+        std::vector<int> worker_cores;
+        mutable std::mutex lock;
+        std::condition_variable ready_or_done;
+        std::vector<std::deque<std::size_t>> ready;     // per NUMA node
+        std::size_t ready_count;
+        std::size_t completed;
+        bool stopping;
+    };
+
+    // what a system can do during its update
+    class TickContext
+    {
+    public:
+        TickContext(TickScheduler& owner, std::size_t index) : scheduler(owner), self(index)
+        {}
+
+        // calls function(const E&) for every event of type E this system gets to see this tick
+        template <typename E, typename Function>
+        void for_each(Function function) const;
+        std::size_t count(const TypeInfo& type) const;
+
+        // the event becomes visible to consumers according to the registration order
+        template <typename E, typename... Args>
+        void emit(Args&&... args)
+        {
+            output(type_of<E>()).push_back(make_shared_event<E>(std::forward<Args>(args)...));
+        }
+
+        std::uint64_t get_tick() const { return scheduler.tick_count; }
+        std::size_t get_system() const { return self; }
+    private:
+        std::size_t consumed_slot(const TypeInfo& type) const;
+        std::vector<SharedEvent>& output(const TypeInfo& type);
+        // the buffer of source that this system reads
+        const std::vector<SharedEvent>& input(const TickScheduler::Source& source) const
+        {
+            const TickScheduler::SystemEntry& producer = *scheduler.systems[source.producer];
+            return source.producer < self ? producer.current[source.slot] : producer.previous[source.slot];
+        }
+
+        TickScheduler& scheduler;
+        std::size_t self;
+    };
+
+    template <typename E, typename Function>
+    void TickContext::for_each(Function function) const
+    {
+        const TypeInfo type = type_of<E>();
+        const std::vector<TickScheduler::Source>& sources = scheduler.systems[self]->sources[consumed_slot(type)];
+
+        for (const SharedEvent& event : scheduler.external)
+        {
+            if (event.get_type() == type)
+                function(event.as<E>());
+        }
+        // last tick's events (from the producers that run at or after this system) come first
+        for (const TickScheduler::Source& source : sources)
+        {
+            if (source.producer >= self)
+            {
+                for (const SharedEvent& event : input(source))
+                    function(event.as<E>());
+            }
+        }
+        for (const TickScheduler::Source& source : sources)
+        {
+            if (source.producer < self)
+            {
+                for (const SharedEvent& event : input(source))
+                    function(event.as<E>());
+            }
+        }
+    }
+}
@@ -0,0 +1,318 @@
+#include "topic_channels.hh"
+
+#include <algorithm>
+
+namespace cs225
+{
+    TopicChannels TopicChannels::instance;
+    const std::uint32_t TopicChannels::no_node;
+    const std::uint32_t TopicChannels::wildcard_one;
+    const std::uint32_t TopicChannels::wildcard_rest;
+
+    TopicChannels::TopicChannels()
+        : topics(1, Topic{0, 0, 0, std::string()}), routes(1), patterns(1), pattern_generation{1}, publish_depth{0}
+    {}
+
+    TopicId TopicChannels::intern(const std::string& name)
+    {
+        std::vector<std::uint32_t> segments = parse(name, false);
+        TopicId topic = 0;
+        for (std::uint32_t segment : segments)
+        {
+            auto found_it = topic_children.find(child_key(topic, segment));
+            topic = found_it != topic_children.end() ? found_it->second : add_topic(topic, segment);
+        }
+        return topic;
+    }
+
+    TopicId TopicChannels::find(const std::string& name) const
+    {
+        std::vector<std::uint32_t> segments;
+        if (!lookup_segments(name, segments))
+            return 0;
+
+        TopicId topic = 0;
+        for (std::uint32_t segment : segments)
+        {
+            auto found_it = topic_children.find(child_key(topic, segment));
+            if (found_it == topic_children.end())
+                return 0;
+            topic = found_it->second;
+        }
+        return topic;
+    }
+
+    TopicToken TopicChannels::subscribe(Listener& listener, TopicId topic)
+    {
+        if (topic == 0 || topic >= topics.size())
+            throw InvalidTopic("unknown topic id");
+        SlotKey key = subscriptions.insert(Subscription{&listener, topic, no_node, false});
+        routes[topic].exact.push_back(key);
+        return TopicToken{key};
+    }
+
+    TopicToken TopicChannels::subscribe(Listener& listener, const std::string& pattern)
+    {
+        std::vector<std::uint32_t> segments = parse(pattern, true);
+        if (std::find_if(segments.begin(), segments.end(), [](std::uint32_t segment)
+            {
+                return segment == wildcard_one || segment == wildcard_rest;
+            }) == segments.end())
+        {
+            return subscribe(listener, intern(pattern));
+        }
+
+        // nodes are referred to by index, the vector grows along the way
+        std::uint32_t node = 0;
+        bool rest = false;
+        for (std::uint32_t segment : segments)
+        {
+            if (segment == wildcard_rest)
+            {
+                rest = true;
+                break;
+            }
+
+            std::uint32_t child = no_node;
+            if (segment == wildcard_one)
+            {
+                child = patterns[node].any_child;
+            }
+            else
+            {
+                auto found_it = patterns[node].children.find(segment);
+                if (found_it != patterns[node].children.end())
+                    child = found_it->second;
+            }
+            if (child == no_node)
+            {
+                child = static_cast<std::uint32_t>(patterns.size());
+                patterns.push_back(PatternNode());
+                if (segment == wildcard_one)
+                    patterns[node].any_child = child;
+                else
+                    patterns[node].children.emplace(segment, child);
+            }
+            node = child;
+        }
+
+        SlotKey key = subscriptions.insert(Subscription{&listener, 0, node, rest});
+        (rest ? patterns[node].rest : patterns[node].here).push_back(key);
+        pattern_generation++;
+        return TopicToken{key};
+    }
+
+    bool TopicChannels::unsubscribe(const TopicToken& token)
+    {
+        const Subscription* found = subscriptions.find(token.key);
+        if (!found)
+            return false;
+        const Subscription subscription = *found;
+        subscriptions.erase(token.key);
+
+        if (subscription.topic == 0)
+        {
+            // the matches are recomputed on the next publish
+            PatternNode& node = patterns[subscription.pattern];
+            std::vector<SlotKey>& keys = subscription.rest ? node.rest : node.here;
+            keys.erase(std::find(keys.begin(), keys.end(), token.key));
+            pattern_generation++;
+        }
+        else if (publish_depth == 0)
+        {
+            std::vector<SlotKey>& keys = routes[subscription.topic].exact;
+            keys.erase(std::find(keys.begin(), keys.end(), token.key));
+        }
+        else
+        {
+            // the list may be being published to; the stale key is skipped and pruned later
+            Route& route = routes[subscription.topic];
+            if (!route.has_stale)
+                stale_routes.push_back(subscription.topic);
+            route.has_stale = true;
+        }
+        return true;
+    }
+
+    void TopicChannels::clear()
+    {
+        subscriptions.clear();
+        for (Route& route : routes)
+        {
+            route.exact.clear();
+            route.matched.clear();
+            route.has_stale = false;
+        }
+        patterns.assign(1, PatternNode());
+        pattern_generation++;
+        stale_routes.clear();
+    }
+
+    void TopicChannels::publish(const TopicEvent& event)
+    {
+        const TopicId topic = event.get_topic();
+        if (topic == 0 || topic >= topics.size())
+            throw InvalidTopic("unknown topic id");
+        match(topic);
+
+        ++publish_depth;
+        try
+        {
+            deliver(event, topic, &Route::exact);
+            deliver(event, topic, &Route::matched);
+        }
+        catch (...)
+        {
+            if (--publish_depth == 0)
+                prune_stale_routes();
+            throw;
+        }
+        if (--publish_depth == 0)
+            prune_stale_routes();
+    }
+
+    bool TopicChannels::has_subscribers(TopicId topic)
+    {
+        if (topic == 0 || topic >= topics.size())
+            return false;
+        match(topic);
+        return !routes[topic].exact.empty() || !routes[topic].matched.empty();
+    }
+
+    std::vector<std::uint32_t> TopicChannels::parse(const std::string& name, bool pattern)
+    {
+        std::vector<std::uint32_t> segments;
+        std::size_t begin = 0;
+        while (true)
+        {
+            std::size_t end = name.find('/', begin);
+            if (end == std::string::npos)
+                end = name.size();
+            const std::string segment = name.substr(begin, end - begin);
+            if (segment.empty())
+                throw InvalidTopic("empty level in topic '" + name + "'");
+
+            if (segment == "*" || segment == "#")
+            {
+                if (!pattern)
+                    throw InvalidTopic("wildcard in topic name '" + name + "'");
+                if (segment == "#" && end != name.size())
+                    throw InvalidTopic("'#' is not the last level of '" + name + "'");
+                segments.push_back(segment == "*" ? wildcard_one : wildcard_rest);
+            }
+            else
+            {
+                if (segment.find_first_of("*#") != std::string::npos)
+                    throw InvalidTopic("wildcard inside a level of '" + name + "'");
+                auto found_it = segment_ids.find(segment);
+                if (found_it == segment_ids.end())
+                {
+                    found_it = segment_ids.emplace(segment, static_cast<std::uint32_t>(segment_names.size())).first;
+                    segment_names.push_back(segment);
+                }
+                segments.push_back(found_it->second);
+            }
+
+            if (end == name.size())
+                return segments;
+            begin = end + 1;
+        }
+    }
+
+    bool TopicChannels::lookup_segments(const std::string& name, std::vector<std::uint32_t>& segments) const
+    {
+        std::size_t begin = 0;
+        while (true)
+        {
+            std::size_t end = name.find('/', begin);
+            if (end == std::string::npos)
+                end = name.size();
+            auto found_it = segment_ids.find(name.substr(begin, end - begin));
+            if (found_it == segment_ids.end())
+                return false;
+            segments.push_back(found_it->second);
+
+            if (end == name.size())
+                return true;
+            begin = end + 1;
+        }
+    }
+
+    TopicId TopicChannels::add_topic(TopicId parent, std::uint32_t segment)
+    {
+        const TopicId topic = static_cast<TopicId>(topics.size());
+        const std::string& segment_name = segment_names[segment];
+        const std::string name = parent == 0 ? segment_name : topics[parent].name + "/" + segment_name;
+        topics.push_back(Topic{parent, segment, topics[parent].depth + 1, name});
+        routes.push_back(Route());
+        topic_children.emplace(child_key(parent, segment), topic);
+        return topic;
+    }
+
+    void TopicChannels::match(TopicId topic)
+    {
+        Route& route = routes[topic];
+        // the matches may be being published to, they are only replaced at the outermost level
+        if (route.matched_generation == pattern_generation || (publish_depth > 0 && route.matched_generation != 0))
+            return;
+
+        std::vector<std::uint32_t> path(topics[topic].depth);
+        for (TopicId level = topic; level != 0; level = topics[level].parent)
+            path[topics[level].depth - 1] = topics[level].segment;
+
+        route.matched.clear();
+        collect(0, path, 0, route.matched);
+        route.matched_generation = pattern_generation;
+    }
+
+    void TopicChannels::collect(std::uint32_t node, const std::vector<std::uint32_t>& path, std::size_t level,
+                                std::vector<SlotKey>& matches) const
+    {
+        const PatternNode& pattern = patterns[node];
+        // '#' matches the remaining levels, however many
+        matches.insert(matches.end(), pattern.rest.begin(), pattern.rest.end());
+        if (level == path.size())
+        {
+            matches.insert(matches.end(), pattern.here.begin(), pattern.here.end());
+            return;
+        }
+
+        auto found_it = pattern.children.find(path[level]);
+        if (found_it != pattern.children.end())
+            collect(found_it->second, path, level + 1, matches);
+        if (pattern.any_child != no_node)
+            collect(pattern.any_child, path, level + 1, matches);
+    }
+
+    void TopicChannels::deliver(const TopicEvent& event, TopicId topic, std::vector<SlotKey> Route::* list)
+    {
+        // handlers may intern topics (moving the routes) and subscribe (growing the list):
+        // look the list up again for every subscriber, up to its size at the start
+        const std::size_t count = (routes[topic].*list).size();
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const std::vector<SlotKey>& keys = routes[topic].*list;
+            if (i >= keys.size())
+                return; // cleared
+            if (const Subscription* subscription = subscriptions.find(keys[i]))
+            {
+                Listener* listener = subscription->listener;
+                listener->handle_event(event);
+            }
+        }
+    }
+
+    void TopicChannels::prune_stale_routes()
+    {
+        for (TopicId topic : stale_routes)
+        {
+            std::vector<SlotKey>& keys = routes[topic].exact;
+            keys.erase(std::remove_if(keys.begin(), keys.end(), [this](const SlotKey& key)
+            {
+                return !subscriptions.contains(key);
+            }), keys.end());
+            routes[topic].has_stale = false;
+        }
+        stale_routes.clear();
+    }
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "event.hh"
+#include "event_dispatcher.hh"
+#include "slot_map.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cs225
+{
+    // dense index of an interned topic name; 0 stands for no topic
+    using TopicId = std::uint32_t;
+
+    // an event published on a named topic, for events that are only known at runtime
+    // (e.g. defined by configuration) and so have no Event subclass of their own
+    class TopicEvent : public Event
+    {
+    public:
+        explicit TopicEvent(TopicId id, const std::string& data = std::string())
+            : topic{id}, payload(data)
+        {}
+
+        TopicId get_topic() const { return topic; }
+        const std::string& get_payload() const { return payload; }
+    private:
+        TopicId topic;
+        std::string payload;
+    };
+
+    // thrown for malformed topic names and patterns
+    class InvalidTopic : public std::invalid_argument
+    {
+    public:
+        explicit InvalidTopic(const std::string& what) : std::invalid_argument(what)
+        {}
+    };
+
+    // identifies a single topic subscription
+    // tokens become stale once unsubscribed or after TopicChannels::clear
+    struct TopicToken
+    {
+        SlotKey key;
+    };
+
+    // routes TopicEvents by topic name, alongside the type-keyed EventDispatcher
+    //
+    // topic names are hierarchical ("sensors/kitchen/temperature") and interned once into
+    // dense TopicIds; subscriptions take either a topic or a pattern where '*' matches one
+    // level and a final '#' matches any number of levels (none included)
+    // patterns are kept in a trie of interned segments, and the subscribers matching each
+    // topic are worked out the first time the topic is published after a change, so that
+    // publishing is an array lookup by id, with no string hashing or comparisons
+    //
+    // subscribers are called in subscription order, exact ones first; unsubscribed listeners
+    // stop receiving events right away, but subscriptions made while publishing may miss
+    // the events published before the outermost publish returns
+    class TopicChannels
+    {
+    public:
+        static TopicChannels& get_instance()
+        {
+            return instance;
+        }
+
+        TopicChannels();
+        TopicChannels(const TopicChannels&) = delete;
+        TopicChannels& operator=(const TopicChannels&) = delete;
+
+        // returns the id of the topic, interning it (and its parents) on first use
+        TopicId intern(const std::string& name);
+        // 0 if the topic was never interned
+        TopicId find(const std::string& name) const;
+        const std::string& get_name(TopicId topic) const { return topics[topic].name; }
+        TopicId get_parent(TopicId topic) const { return topics[topic].parent; }
+        std::size_t get_topic_count() const { return topics.size() - 1; }
+
+        TopicToken subscribe(Listener& listener, TopicId topic);
+        // the pattern may use wildcards; a pattern without them is the same as its topic
+        TopicToken subscribe(Listener& listener, const std::string& pattern);
+        // returns false if the token was stale
+        bool unsubscribe(const TopicToken& token);
+        // drops every subscription (interned topics keep their ids)
+        void clear();
+
+        void publish(const TopicEvent& event);
+        void publish(TopicId topic, const std::string& payload = std::string())
+        {
+            if (has_subscribers(topic))
+                publish(TopicEvent(topic, payload));
+        }
+        bool has_subscribers(TopicId topic);
+    private:
+        static const std::uint32_t no_node = 0;
+        static const std::uint32_t wildcard_one = 0xffffffffu;      // '*'
+        static const std::uint32_t wildcard_rest = 0xfffffffeu;     // '#'
+
+        struct Topic
+        {
+            TopicId parent;
+            std::uint32_t segment;
+            std::uint32_t depth;
+            std::string name;
+        };
+
+        struct Subscription
+        {
+            Listener* listener;
+            TopicId topic;              // 0 for a wildcard pattern
+            std::uint32_t pattern;      // the trie node of a wildcard pattern
+            bool rest;                  // a '#' pattern (in the node's rest list)
+        };
+
+        // a node of the pattern trie, the root is the empty pattern
+        struct PatternNode
+        {
+            std::unordered_map<std::uint32_t, std::uint32_t> children;
+            std::uint32_t any_child;            // child for '*' (no_node if none)
+            std::vector<SlotKey> here;          // patterns ending here
+            std::vector<SlotKey> rest;          // patterns ending here with '#'
+        };
+
+        // the subscribers of a topic
+        struct Route
+        {
+            std::vector<SlotKey> exact;
+            std::vector<SlotKey> matched;       // wildcard patterns, as of matched_generation
+            std::uint64_t matched_generation;
+            bool has_stale;                     // exact holds unsubscribed keys
+        };
+
+        // splits a name into interned segments; wildcards are only allowed in patterns
+        std::vector<std::uint32_t> parse(const std::string& name, bool pattern);
+        bool lookup_segments(const std::string& name, std::vector<std::uint32_t>& segments) const;
+        TopicId add_topic(TopicId parent, std::uint32_t segment);
+        static std::uint64_t child_key(TopicId parent, std::uint32_t segment)
+        {
+            return (static_cast<std::uint64_t>(parent) << 32) | segment;
+        }
+
+        // brings the wildcard matches of the topic up to date
+        void match(TopicId topic);
+        void collect(std::uint32_t node, const std::vector<std::uint32_t>& path, std::size_t level,
+                     std::vector<SlotKey>& matches) const;
+        void deliver(const TopicEvent& event, TopicId topic, std::vector<SlotKey> Route::* list);
+        void prune_stale_routes();
+
+        // interned topics, indexed by TopicId (the first one stands for no topic)
+        std::vector<Topic> topics;
+        std::vector<Route> routes;
+        std::unordered_map<std::string, std::uint32_t> segment_ids;
+        std::vector<std::string> segment_names;
+        std::unordered_map<std::uint64_t, TopicId> topic_children;
+
+        SlotMap<Subscription> subscriptions;
+        std::vector<PatternNode> patterns;
+        // bumped by every change of the wildcard patterns
+        std::uint64_t pattern_generation;
+        std::vector<TopicId> stale_routes;
+        std::size_t publish_depth;
+
+        static TopicChannels instance;
+    };
+
+    // proxy functions
+    inline void publish(TopicId topic, const std::string& payload = std::string())
+    {
+        TopicChannels::get_instance().publish(topic, payload);
+    }
+}
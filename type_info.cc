@@ -1,26 +1,99 @@
 #include "type_info.hh"
 
-bool operator==(const TypeInfo& a, const TypeInfo& b)
-{
-    return a.get_name() == b.get_name();
-}
-bool operator!=(const TypeInfo& a, const TypeInfo& b)
-{
-     return !(a == b);
-}
+#include <typeindex>
+#include <unordered_map>
 
-bool operator<(const TypeInfo& a, const TypeInfo& b)
-{
-    return a.get_name() < b.get_name();
-}
+#if defined(__GNUC__)
+    #include <cxxabi.h>
+    #include <cstdlib>
+#endif
 
-template <typename T>
-TypeInfo type_of(const T& object)
+namespace cs225
 {
-    return TypeInfo{object};
+    namespace
+    {
+        struct RegisteredType
+        {
+            const std::type_info* info;
+            std::string name;
+        };
+
+        // function statics, so that registration works during static initialization
+        std::unordered_map<std::uint64_t, RegisteredType>& types_by_hash()
+        {
+            static std::unordered_map<std::uint64_t, RegisteredType> types;
+            return types;
+        }
+        std::unordered_map<std::type_index, std::uint64_t>& hashes_by_type()
+        {
+            static std::unordered_map<std::type_index, std::uint64_t> hashes;
+            return hashes;
+        }
+
+        std::string demangle(const char* name)
+        {
+        #if defined(__GNUC__)
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+            if (status == 0 && demangled)
+            {
+                std::string result(demangled);
+                std::free(demangled);
+                return result;
+            }
+        #endif
+            return name;
+        }
+    }
+
+    bool TypeRegistry::register_type(const std::type_info& info, std::uint64_t hash, const std::string& name)
+    {
+        if (hash == unregistered_type_hash)
+            throw TypeHashCollision("type " + name + " has the hash reserved for unregistered types");
+        auto found_it = types_by_hash().find(hash);
+        if (found_it != types_by_hash().end())
+        {
+            if (*found_it->second.info == info)
+                return true;
+            throw TypeHashCollision("type hash collision between " + found_it->second.name + " and " + name);
+        }
+
+        types_by_hash().insert(std::make_pair(hash, RegisteredType{&info, name}));
+        hashes_by_type().insert(std::make_pair(std::type_index(info), hash));
+        return true;
+    }
+
+    std::uint64_t TypeRegistry::hash_of(const std::type_info& info)
+    {
+        auto found_it = hashes_by_type().find(std::type_index(info));
+        if (found_it != hashes_by_type().end())
+            return found_it->second;
+        throw UnregisteredType("type " + demangle(info.name()) + " is not registered");
+    }
+
+    std::uint64_t TypeRegistry::try_hash_of(const std::type_info& info)
+    {
+        auto found_it = hashes_by_type().find(std::type_index(info));
+        return found_it != hashes_by_type().end() ? found_it->second : unregistered_type_hash;
+    }
+
+    const std::type_info* TypeRegistry::find(std::uint64_t hash)
+    {
+        auto found_it = types_by_hash().find(hash);
+        return found_it != types_by_hash().end() ? found_it->second.info : nullptr;
+    }
+
+    std::string TypeRegistry::name_of(std::uint64_t hash)
+    {
+        auto found_it = types_by_hash().find(hash);
+        return found_it != types_by_hash().end() ? found_it->second.name : std::string();
+    }
+
+    TypeInfo TypeInfo::from_hash(std::uint64_t type_hash)
+    {
+        const std::type_info* info = TypeRegistry::find(type_hash);
+        if (!info)
+            throw std::out_of_range("no registered type has this hash");
+        return TypeInfo(*info, type_hash);
+    }
 }
-template <typename T>
-TypeInfo type_of()
-{
-    return TypeInfo(typeid(T));
-}
\ No newline at end of file
@@ -1,33 +1,207 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
 #include <typeinfo>
+#include <type_traits>
 #include <string>
 
 namespace cs225
 {
+    namespace detail
+    {
+        const std::uint64_t fnv1a_offset = 14695981039346656037ull;
+        const std::uint64_t fnv1a_prime = 1099511628211ull;
+
+        constexpr std::uint64_t fnv1a_step(std::uint64_t hash, char c)
+        {
+            return (hash ^ static_cast<unsigned char>(c)) * fnv1a_prime;
+        }
+
+        // hashes `length` characters, four per call to keep the constexpr recursion shallow
+        constexpr std::uint64_t fnv1a(const char* text, std::size_t length, std::uint64_t hash)
+        {
+            return length == 0 ? hash
+                 : length == 1 ? fnv1a_step(hash, text[0])
+                 : length == 2 ? fnv1a_step(fnv1a_step(hash, text[0]), text[1])
+                 : length == 3 ? fnv1a_step(fnv1a_step(fnv1a_step(hash, text[0]), text[1]), text[2])
+                 : fnv1a(text + 4, length - 4,
+                         fnv1a_step(fnv1a_step(fnv1a_step(fnv1a_step(hash, text[0]), text[1]), text[2]), text[3]));
+        }
+
+        constexpr std::size_t length(const char* text, std::size_t count = 0)
+        {
+            return !text[0] ? count
+                 : !text[1] ? count + 1
+                 : !text[2] ? count + 2
+                 : !text[3] ? count + 3
+                 : length(text + 4, count + 4);
+        }
+
+        // __PRETTY_FUNCTION__ reads "... signature() [with T = <type name>]" (GCC)
+        // or "... signature() [T = <type name>]" (Clang)
+        template <typename T>
+        constexpr const char* signature()
+        {
+            return __PRETTY_FUNCTION__;
+        }
+
+        constexpr const char* skip_to_type_name(const char* signature)
+        {
+            return signature[0] == 'T' && signature[1] == ' ' && signature[2] == '=' && signature[3] == ' '
+                 ? signature + 4
+                 : skip_to_type_name(signature + 1);
+        }
+
+        // the type name runs up to the closing bracket at the end of the signature
+        constexpr std::uint64_t hash_type_name(const char* name)
+        {
+            return fnv1a(name, length(name) - 1, fnv1a_offset);
+        }
+    }
+
+    // 64-bit FNV-1a hash of a string, usable in constant expressions
+    constexpr std::uint64_t fnv1a(const char* text)
+    {
+        return detail::fnv1a(text, detail::length(text), detail::fnv1a_offset);
+    }
+
+    // stable identity of a type, computed at compile time from its fully qualified name:
+    // unlike std::type_info it means the same thing across processes, builds and recorded logs
+    // (as long as the compiler spells type names the same way)
+    template <typename T>
+    constexpr std::uint64_t type_hash()
+    {
+        return detail::hash_type_name(detail::skip_to_type_name(detail::signature<T>()));
+    }
+
+    // fully qualified name of a type, as hashed by type_hash
+    template <typename T>
+    std::string type_name()
+    {
+        const char* name = detail::skip_to_type_name(detail::signature<T>());
+        return std::string(name, detail::length(name) - 1);
+    }
+
+    struct TypeHashCollision : public std::logic_error
+    {
+        explicit TypeHashCollision(const std::string& message) : std::logic_error(message)
+        {}
+    };
+
+    // the hash of the types that were never registered (see TypeRegistry::try_hash_of),
+    // reserved: no registered type has it
+    const std::uint64_t unregistered_type_hash = 0;
+
+    // a type never named statically (through type_of<T>() and the like) has no stable hash
+    struct UnregisteredType : public std::logic_error
+    {
+        explicit UnregisteredType(const std::string& message) : std::logic_error(message)
+        {}
+    };
+
+    // maps std::type_info to stable hashes and back
+    // every type named through type_of<T>() is registered during static initialization,
+    // so collisions are detected at startup and the registry is read-only afterwards
+    class TypeRegistry
+    {
+    public:
+        // throws TypeHashCollision if the hash already belongs to a different type (or is
+        // unregistered_type_hash)
+        static bool register_type(const std::type_info& info, std::uint64_t hash, const std::string& name);
+
+        // hash of a registered type, as computed by type_hash
+        // throws UnregisteredType for types only ever seen through a base class reference:
+        // their hash can't be rebuilt at run time, and any other one may not match type_hash
+        static std::uint64_t hash_of(const std::type_info& info);
+        // same, but unregistered types get unregistered_type_hash: such a type can have no
+        // handlers or subscribers, so events of it are simply not delivered
+        static std::uint64_t try_hash_of(const std::type_info& info);
+        // null if no registered type has this hash
+        static const std::type_info* find(std::uint64_t hash);
+        // stable name of a registered type (empty if unknown)
+        static std::string name_of(std::uint64_t hash);
+    };
+
+    template <typename T>
+    struct TypeRegistration
+    {
+        static const bool registered;
+    };
+    template <typename T>
+    const bool TypeRegistration<T>::registered = TypeRegistry::register_type(typeid(T), type_hash<T>(), type_name<T>());
+
     class TypeInfo
     {
     public:
+        TypeInfo() : info{&typeid(void)}, hash{type_hash<void>()}
+        {}
         template <typename T>
-        TypeInfo(const T& object) : TypeInfo{typeid(object)}
+        TypeInfo(const T& object) : TypeInfo{(static_cast<void>(TypeRegistration<T>::registered), typeid(object))}
         {}
-        TypeInfo(const std::type_info& ti) : info{ti}
+        TypeInfo(const std::type_info& ti) : info{&ti}, hash{TypeRegistry::hash_of(ti)}
         {}
-        const char* get_name()
+        TypeInfo(const std::type_info& ti, std::uint64_t type_hash) : info{&ti}, hash{type_hash}
+        {}
+        const char* get_name() const
+        {
+            return info->name();
+        }
+        const std::type_info& get_type_info() const
+        {
+            return *info;
+        }
+        std::uint64_t get_hash() const
         {
-            return info.name();
+            return hash;
         }
+        // false for a type only seen through a base class reference, that was never registered
+        bool is_registered() const
+        {
+            return hash != unregistered_type_hash;
+        }
+
+        // rebuilds the type info of a registered type from its hash (e.g. read from a stream)
+        // throws std::out_of_range if no registered type has this hash
+        static TypeInfo from_hash(std::uint64_t type_hash);
     private:
-        const std::type_info& info;
+        // held by pointer so that type infos can be reassigned (e.g. inside subscription tokens)
+        const std::type_info* info;
+        std::uint64_t hash;
     };
 
-    bool operator==(const TypeInfo& a, const TypeInfo& b);
-    bool operator!=(const TypeInfo& a, const TypeInfo& b);
+    // comparisons only look at the stable hashes
+    // (ordering by hash is arbitrary but the same on every run)
+    // (inline, they are on the dispatch path)
+    inline bool operator==(const TypeInfo& a, const TypeInfo& b)
+    {
+        return a.get_hash() == b.get_hash();
+    }
+    inline bool operator!=(const TypeInfo& a, const TypeInfo& b)
+    {
+        return !(a == b);
+    }
 
-    bool operator<(const TypeInfo& a, const TypeInfo& b);
+    inline bool operator<(const TypeInfo& a, const TypeInfo& b)
+    {
+        return a.get_hash() < b.get_hash();
+    }
 
     template <typename T>
-    TypeInfo type_of(const T& object);
+    TypeInfo type_of()
+    {
+        // typeid ignores cv-qualifiers, so must the hash
+        using type = typename std::remove_cv<T>::type;
+        (void)TypeRegistration<type>::registered;
+        return TypeInfo(typeid(type), type_hash<type>());
+    }
     template <typename T>
-    TypeInfo type_of();
-}
\ No newline at end of file
+    TypeInfo type_of(const T& object)
+    {
+        // the static type is known (and registered) unless the object is seen through a base class
+        if (typeid(object) == typeid(T))
+            return type_of<T>();
+        return TypeInfo{typeid(object), TypeRegistry::try_hash_of(typeid(object))};
+    }
+}
@@ -0,0 +1,106 @@
+#include "watchdog.hh"
+#include "event_dispatcher.hh"
+
+namespace cs225
+{
+    std::vector<SlowHandlerRecord> SlowHandlerLog::get_records() const
+    {
+        std::vector<SlowHandlerRecord> ordered;
+        const std::size_t kept = total < records.size() ? static_cast<std::size_t>(total) : records.size();
+        for (std::uint64_t i = total - kept; i < total; ++i)
+            ordered.push_back(records[i % records.size()]);
+        return ordered;
+    }
+
+    void SlowHandlerLog::set_capacity(std::size_t capacity)
+    {
+        records.assign(capacity, SlowHandlerRecord{});
+        total = 0;
+    }
+
+    AsyncDeliveryWorker::~AsyncDeliveryWorker()
+    {
+        // the worker delivers what is left, then stops
+        pending.close();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    bool AsyncDeliveryWorker::post(Listener& listener, const SharedEvent& event)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!worker.joinable())
+                worker = std::thread([this]() { run(); });
+        }
+        return pending.push(std::make_pair(&listener, event));
+    }
+
+    void AsyncDeliveryWorker::flush()
+    {
+        // every popped event is counted as delivered once handled
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [this]() { return pending.size() == 0 && delivered == pending.get_counters().popped; });
+    }
+
+    std::uint64_t AsyncDeliveryWorker::get_delivered() const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return delivered;
+    }
+
+    std::uint64_t AsyncDeliveryWorker::get_failed() const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return failed;
+    }
+
+    void AsyncDeliveryWorker::set_placement(const ThreadPlacement& placement)
+    {
+        const int planned = CpuTopology::get_host().plan(placement, 1).front();
+        std::lock_guard<std::mutex> guard(lock);
+        if (planned != CpuTopology::no_core)
+            core = planned;
+    }
+
+    int AsyncDeliveryWorker::get_core() const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return pinned_core;
+    }
+
+    void AsyncDeliveryWorker::run()
+    {
+        std::pair<Listener*, SharedEvent> delivery;
+        // false once closed, with nothing left to deliver
+        while (pending.pop(delivery))
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (core != pinned_core)
+                {
+                    if (pin_current_thread(static_cast<unsigned>(core)))
+                        pinned_core = core;
+                    // don't try again until the placement changes
+                    core = pinned_core;
+                }
+            }
+
+            bool ok = true;
+            try
+            {
+                delivery.first->handle_event(*delivery.second);
+            }
+            catch (...)
+            {
+                ok = false;
+            }
+            delivery.second.reset();
+
+            std::lock_guard<std::mutex> guard(lock);
+            delivered++;
+            failed += !ok;
+            changed.notify_all();
+        }
+    }
+}
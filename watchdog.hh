@@ -0,0 +1,127 @@
+#pragma once
+
+#include "bounded_queue.hh"
+#include "event.hh"
+#include "shared_event.hh"
+#include "thread_placement.hh"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cs225
+{
+    class Listener;
+
+    // latency budgets for the slow-handler watchdog of the EventDispatcher
+    // a zero budget is no budget; with both at zero the watchdog is off and nothing is timed
+    struct LatencyBudget
+    {
+        LatencyBudget(std::chrono::nanoseconds listener = std::chrono::nanoseconds::zero(),
+                      std::chrono::nanoseconds dispatch = std::chrono::nanoseconds::zero(),
+                      std::size_t offenses = 0)
+            : per_listener{listener}, per_dispatch{dispatch}, demote_after{offenses}
+        {}
+
+        bool enabled() const
+        {
+            return per_listener != std::chrono::nanoseconds::zero() || per_dispatch != std::chrono::nanoseconds::zero();
+        }
+
+        std::chrono::nanoseconds per_listener;  // a single handle_event call
+        std::chrono::nanoseconds per_dispatch;  // all the handlers of an event
+        // listeners over their budget this many times are demoted to an asynchronous
+        // worker (0: never)
+        std::size_t demote_after;
+    };
+
+    // a handler (or a whole dispatch) that went over its budget
+    struct SlowHandlerRecord
+    {
+        const char* listener_type;      // null for a whole dispatch
+        const char* event_type;
+        std::chrono::nanoseconds duration;
+    };
+
+    // the last records of slow handlers, older ones are overwritten
+    class SlowHandlerLog
+    {
+    public:
+        explicit SlowHandlerLog(std::size_t capacity = 64) : records(capacity), total{0}
+        {}
+
+        void record(const SlowHandlerRecord& slow)
+        {
+            if (records.empty())
+                return;
+            records[total % records.size()] = slow;
+            total++;
+        }
+        // oldest first
+        std::vector<SlowHandlerRecord> get_records() const;
+        // records ever made, including the overwritten ones
+        std::uint64_t get_total() const { return total; }
+        std::size_t get_capacity() const { return records.size(); }
+
+        // drops the records
+        void set_capacity(std::size_t capacity);
+        void clear() { total = 0; }
+    private:
+        std::vector<SlowHandlerRecord> records;
+        std::uint64_t total;
+    };
+
+    // delivers events to demoted listeners on a thread of its own (started on first use),
+    // so they don't hold up the synchronous dispatch
+    // a demoted listener is one that can't keep up, so its events wait in a bounded queue
+    // (1024 events, dropping the oldest by default)
+    class AsyncDeliveryWorker
+    {
+    public:
+        AsyncDeliveryWorker()
+            : pending(QueueLimit(1024u, OverflowPolicy::drop_oldest))
+            , core{CpuTopology::no_core}, pinned_core{CpuTopology::no_core}, delivered{0}, failed{0}
+        {}
+        AsyncDeliveryWorker(const AsyncDeliveryWorker&) = delete;
+        AsyncDeliveryWorker& operator=(const AsyncDeliveryWorker&) = delete;
+        ~AsyncDeliveryWorker();
+
+        // returns false if the event was dropped
+        // (a blocking limit makes the dispatching thread wait for the worker)
+        bool post(Listener& listener, const SharedEvent& event);
+        // waits until every posted event was handled (or dropped)
+        void flush();
+
+        void set_queue_limit(const QueueLimit& limit) { pending.set_limit(limit); }
+        QueueCounters get_queue_counters() const { return pending.get_counters(); }
+
+        std::uint64_t get_delivered() const;
+        // handlers that threw (there is no dispatch to report it to)
+        std::uint64_t get_failed() const;
+        // events dropped by the queue limit
+        std::uint64_t get_dropped() const { return pending.get_counters().dropped; }
+
+        // pins the thread (before its next delivery) to the first core of the placement;
+        // a thread that was pinned stays where it is with PlacementPolicy::none
+        void set_placement(const ThreadPlacement& placement);
+        // the core the thread is pinned to (CpuTopology::no_core if it isn't)
+        int get_core() const;
+    private:
+        void run();
+
+        // taken before the lock of the queue, never after it
+        mutable std::mutex lock;
+        std::condition_variable changed;
+        BoundedQueue<std::pair<Listener*, SharedEvent>> pending;
+        std::thread worker;
+        int core;               // requested
+        int pinned_core;
+        std::uint64_t delivered;    // every event popped from the queue, once handled
+        std::uint64_t failed;
+    };
+}